@@ -0,0 +1,279 @@
+/*  Author: <Thelet.Shevach@gmail.com
+ *  bench.cpp : operator benchmarks (size sweeps, median/p99, GFLOP/s, GB/s).
+ *
+ *  bench [--ops mul,pow,det,transpose,add,parse,write,read]
+ *        [--sizes 2,4,...] [--max N] [--reps R] [--warmup W]
+ *        [--budget SEC] [--format table|csv|json] [--out FILE]
+ */
+
+#include "SquareMat.h"
+#include "SquareMat_pool.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using mat::SquareMat;
+using std::size_t;
+using Clock = std::chrono::steady_clock;
+
+namespace {
+
+struct Options {
+    std::vector<std::string> ops   = {"mul", "pow", "det", "transpose", "add", "parse", "write", "read"};
+    std::vector<size_t>      sizes;                 // empty: powers of two up to max
+    size_t                   max_n  = 1024;
+    size_t                   reps   = 15;
+    size_t                   warmup = 2;
+    double                   budget = 2.0;          // seconds of samples per case, past kMinReps
+    std::string              format = "table";
+    std::string              out;
+};
+
+struct Result {
+    std::string         op;
+    size_t              n;
+    size_t              iters;                      // calls per sample
+    std::vector<double> samples;                    // ns per call
+    double              flops;                      // per call
+    double              bytes;                      // per call
+};
+
+/// One benchmark case: setup once, then `run` is timed; flops/bytes model one call.
+struct Case {
+    std::function<void()> run;
+    double                flops;
+    double                bytes;
+};
+
+constexpr unsigned kPow = 8;                        // exponent used by the pow case
+constexpr size_t   kMinReps = 8;                    // taken even past the budget: 8 vs 8 can
+                                                    // reach p = 1/12870 in bench_compare
+
+SquareMat random_mat(size_t n, std::uint32_t seed) {
+    std::mt19937 gen(seed);
+    std::uniform_real_distribution<double> dist(-1.0, 1.0);
+    SquareMat m(n);
+    for (double& v : m) v = dist(gen);
+    for (size_t i = 0; i < n; ++i) m.at_unchecked(i, i) += double(n);   // well conditioned
+    return m;
+}
+
+std::string to_spec(const SquareMat& m) {           // from_string layout
+    std::ostringstream s;
+    s << std::setprecision(17);
+    for (size_t i = 0; i < m.size(); ++i)
+        for (size_t j = 0; j < m.size(); ++j)
+            s << m.at_unchecked(i, j) << (j + 1 < m.size() ? " " : (i + 1 < m.size() ? "," : ""));
+    return s.str();
+}
+
+std::string to_stream(const SquareMat& m) {         // operator>> layout
+    std::ostringstream s;
+    s << std::setprecision(17) << m.size() << '\n';
+    for (double v : m) s << v << ' ';
+    return s.str();
+}
+
+double pow_mults(unsigned p) {                      // products done by operator^ (square-and-multiply)
+    double k = 0;
+    for (--p; p; p >>= 1) k += (p & 1) + (p > 1);
+    return k;
+}
+
+volatile double sink;                               // keeps results observable
+
+Case make_case(const std::string& op, size_t n) {
+    const double n2 = double(n) * n, n3 = n2 * n, d = sizeof(double);
+    auto a = std::make_shared<SquareMat>(random_mat(n, 1));
+    auto b = std::make_shared<SquareMat>(random_mat(n, 2));
+    if (op == "mul")
+        return {[a, b] { SquareMat c = *a * *b; sink = c.data()[0]; }, 2 * n3, 3 * n2 * d};
+    if (op == "pow") {
+        auto s = std::make_shared<SquareMat>(*a / (2.0 * double(n)));    // keep powers finite
+        return {[s] { SquareMat c = *s ^ kPow; sink = c.data()[0]; },
+                pow_mults(kPow) * 2 * n3, (pow_mults(kPow) * 3) * n2 * d};
+    }
+    if (op == "det")
+        return {[a] { sink = !*a; }, 2.0 / 3.0 * n3, n2 * d};
+    if (op == "transpose")
+        return {[a] { SquareMat c = ~*a; sink = c.data()[0]; }, 0, 2 * n2 * d};
+    if (op == "add")
+        return {[a, b] { SquareMat c = *a + *b; sink = c.data()[0]; }, n2, 3 * n2 * d};
+    if (op == "parse") {
+        auto s = std::make_shared<std::string>(to_spec(*a));
+        return {[s] { SquareMat c = SquareMat::from_string(*s); sink = c.data()[0]; }, 0, double(s->size())};
+    }
+    if (op == "write") {
+        std::ostringstream probe;
+        probe << *a;
+        return {[a] { std::ostringstream o; o << *a; sink = double(o.tellp()); },
+                0, double(probe.str().size())};
+    }
+    if (op == "read") {
+        auto s = std::make_shared<std::string>(to_stream(*a));
+        return {[s] { std::istringstream in(*s); SquareMat c(1); in >> c; sink = c.data()[0]; },
+                0, double(s->size())};
+    }
+    throw std::invalid_argument("unknown op: " + op);
+}
+
+double elapsed_ns(Clock::time_point t0) {
+    return std::chrono::duration<double, std::nano>(Clock::now() - t0).count();
+}
+
+Result measure(const std::string& op, size_t n, const Options& opt) {
+    Case c = make_case(op, n);
+    for (size_t w = 0; w < opt.warmup; ++w) c.run();
+
+    // batch tiny calls so one sample is well above clock resolution
+    size_t iters = 1;
+    for (;;) {
+        auto t0 = Clock::now();
+        for (size_t i = 0; i < iters; ++i) c.run();
+        if (elapsed_ns(t0) >= 2e5 || iters >= (size_t(1) << 20)) break;
+        iters *= 4;
+    }
+
+    Result r{op, n, iters, {}, c.flops, c.bytes};
+    const auto deadline = Clock::now() + std::chrono::duration<double>(opt.budget);
+    while (r.samples.size() < opt.reps) {
+        auto t0 = Clock::now();
+        for (size_t i = 0; i < iters; ++i) c.run();
+        r.samples.push_back(elapsed_ns(t0) / double(iters));
+        if (r.samples.size() >= kMinReps && Clock::now() > deadline) break;
+    }
+    return r;
+}
+
+double percentile(std::vector<double> v, double q) {  // nearest rank
+    std::sort(v.begin(), v.end());
+    size_t k = size_t(q * double(v.size()) + 0.999999);
+    return v[std::min(v.size(), std::max<size_t>(k, 1)) - 1];
+}
+
+struct Stats { double median, p99, min, mean, gflops, gbps; };
+
+Stats summarize(const Result& r) {
+    Stats s{};
+    s.median = percentile(r.samples, 0.5);
+    s.p99    = percentile(r.samples, 0.99);
+    s.min    = *std::min_element(r.samples.begin(), r.samples.end());
+    for (double x : r.samples) s.mean += x;
+    s.mean  /= double(r.samples.size());
+    s.gflops = r.flops / s.median;                  // flop/ns == GFLOP/s
+    s.gbps   = r.bytes / s.median;
+    return s;
+}
+
+void write_table(std::ostream& o, const std::vector<Result>& rs) {
+    o << std::left << std::setw(10) << "op" << std::right << std::setw(6) << "n"
+      << std::setw(6) << "reps" << std::setw(14) << "median_ns" << std::setw(14) << "p99_ns"
+      << std::setw(10) << "GFLOP/s" << std::setw(10) << "GB/s" << '\n';
+    o << std::fixed;
+    for (const Result& r : rs) {
+        Stats s = summarize(r);
+        o << std::left << std::setw(10) << r.op << std::right << std::setw(6) << r.n
+          << std::setw(6) << r.samples.size()
+          << std::setprecision(0) << std::setw(14) << s.median << std::setw(14) << s.p99
+          << std::setprecision(3) << std::setw(10) << s.gflops << std::setw(10) << s.gbps << '\n';
+    }
+}
+
+void write_csv(std::ostream& o, const std::vector<Result>& rs) {
+    o << "op,n,reps,iters,median_ns,p99_ns,min_ns,mean_ns,gflops,gbps\n" << std::setprecision(6);
+    for (const Result& r : rs) {
+        Stats s = summarize(r);
+        o << r.op << ',' << r.n << ',' << r.samples.size() << ',' << r.iters << ',' << s.median << ','
+          << s.p99 << ',' << s.min << ',' << s.mean << ',' << s.gflops << ',' << s.gbps << '\n';
+    }
+}
+
+void write_json(std::ostream& o, const std::vector<Result>& rs) {
+    o << std::setprecision(6);
+    o << "{\n  \"meta\": {\"threads\": " << mat::ThreadPool::instance().size() + 1
+      << ", \"compiler\": \"" << __VERSION__ << "\", \"timestamp\": " << std::time(nullptr)
+      << "},\n  \"results\": [";
+    for (size_t k = 0; k < rs.size(); ++k) {
+        const Result& r = rs[k];
+        Stats s = summarize(r);
+        o << (k ? "," : "") << "\n    {\"op\": \"" << r.op << "\", \"n\": " << r.n
+          << ", \"iters\": " << r.iters << ", \"median_ns\": " << s.median << ", \"p99_ns\": " << s.p99
+          << ", \"min_ns\": " << s.min << ", \"mean_ns\": " << s.mean << ", \"gflops\": " << s.gflops
+          << ", \"gbps\": " << s.gbps << ", \"samples_ns\": [";
+        for (size_t i = 0; i < r.samples.size(); ++i) o << (i ? ", " : "") << r.samples[i];
+        o << "]}";
+    }
+    o << "\n  ]\n}\n";
+}
+
+std::vector<std::string> split(const std::string& s) {
+    std::vector<std::string> out;
+    std::stringstream in(s);
+    for (std::string t; std::getline(in, t, ',');) if (!t.empty()) out.push_back(t);
+    return out;
+}
+
+Options parse_args(int argc, char** argv) {
+    Options o;
+    for (int i = 1; i < argc; ++i) {
+        std::string a = argv[i];
+        auto val = [&]() -> std::string {
+            if (i + 1 >= argc) throw std::invalid_argument("missing value for " + a);
+            return argv[++i];
+        };
+        if      (a == "--ops")    o.ops = split(val());
+        else if (a == "--sizes")  for (auto& t : split(val())) o.sizes.push_back(std::stoul(t));
+        else if (a == "--max")    o.max_n  = std::stoul(val());
+        else if (a == "--reps")   o.reps   = std::max<size_t>(1, std::stoul(val()));
+        else if (a == "--warmup") o.warmup = std::stoul(val());
+        else if (a == "--budget") o.budget = std::stod(val());
+        else if (a == "--format") o.format = val();
+        else if (a == "--out")    o.out    = val();
+        else throw std::invalid_argument("unknown option: " + a);
+    }
+    if (o.sizes.empty())
+        for (size_t n = 2; n <= o.max_n; n *= 2) o.sizes.push_back(n);
+    if (o.format != "table" && o.format != "csv" && o.format != "json")
+        throw std::invalid_argument("format must be table, csv or json");
+    return o;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    try {
+        const Options opt = parse_args(argc, argv);
+        std::vector<Result> results;
+        for (const std::string& op : opt.ops)
+            for (size_t n : opt.sizes) {
+                results.push_back(measure(op, n, opt));
+                std::cerr << op << " n=" << n << " done\n";
+            }
+
+        std::ofstream file;
+        if (!opt.out.empty()) {
+            file.open(opt.out);
+            if (!file) throw std::runtime_error("cannot open " + opt.out);
+        }
+        std::ostream& o = opt.out.empty() ? std::cout : file;
+        if      (opt.format == "json") write_json(o, results);
+        else if (opt.format == "csv")  write_csv(o, results);
+        else                           write_table(o, results);
+    } catch (const std::exception& e) {
+        std::cerr << "bench: " << e.what() << '\n';
+        return 2;
+    }
+    return 0;
+}
@@ -0,0 +1,299 @@
+/*  Author: <Thelet.Shevach@gmail.com
+ *  compare.cpp : regression gate for two `bench --format json` result files.
+ *
+ *  bench_compare BASE.json NEW.json [--threshold 0.05] [--alpha 0.01]
+ *                [--op mul=0.10 ...]
+ *
+ *  A case (op, n) regresses when the new median is slower by more than the
+ *  threshold AND a one-sided Mann-Whitney U test on the raw samples says the
+ *  slowdown is significant at `alpha`. A case with too few samples for any
+ *  outcome to reach `alpha` is an error rather than a pass.
+ *  Exit: 0 clean, 1 regression, 2 error (including insufficient samples).
+ */
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstddef>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+using std::size_t;
+
+namespace {
+
+//─── Minimal JSON reader (objects, arrays, strings, numbers, literals) ───
+
+struct Json {
+    enum Kind { Null, Bool, Number, String, Array, Object } kind = Null;
+    double                                        num = 0;
+    std::string                                   str;
+    std::vector<Json>                             arr;
+    std::vector<std::pair<std::string, Json>>     obj;
+
+    const Json* find(const std::string& key) const {
+        for (const auto& kv : obj) if (kv.first == key) return &kv.second;
+        return nullptr;
+    }
+    const Json& at(const std::string& key) const {
+        const Json* j = find(key);
+        if (!j) throw std::runtime_error("missing key \"" + key + "\"");
+        return *j;
+    }
+};
+
+class JsonParser {
+public:
+    explicit JsonParser(const std::string& text) : s(text) {}
+
+    Json parse() {
+        Json j = value();
+        skip_ws();
+        if (pos != s.size()) fail("trailing characters");
+        return j;
+    }
+
+private:
+    const std::string& s;
+    size_t             pos = 0;
+
+    [[noreturn]] void fail(const std::string& what) const {
+        throw std::runtime_error("JSON: " + what + " at position " + std::to_string(pos));
+    }
+    void skip_ws() { while (pos < s.size() && std::isspace(static_cast<unsigned char>(s[pos]))) ++pos; }
+    bool eat(char c) {
+        skip_ws();
+        if (pos < s.size() && s[pos] == c) { ++pos; return true; }
+        return false;
+    }
+    void expect(char c) { if (!eat(c)) fail(std::string("expected '") + c + "'"); }
+
+    Json value() {
+        skip_ws();
+        if (pos >= s.size()) fail("unexpected end");
+        Json j;
+        const char c = s[pos];
+        if (c == '{') {
+            ++pos; j.kind = Json::Object;
+            if (eat('}')) return j;
+            do {
+                skip_ws();
+                std::string key = string();
+                expect(':');
+                j.obj.emplace_back(std::move(key), value());
+            } while (eat(','));
+            expect('}');
+        } else if (c == '[') {
+            ++pos; j.kind = Json::Array;
+            if (eat(']')) return j;
+            do j.arr.push_back(value()); while (eat(','));
+            expect(']');
+        } else if (c == '"') {
+            j.kind = Json::String; j.str = string();
+        } else if (s.compare(pos, 4, "true") == 0)  { pos += 4; j.kind = Json::Bool; j.num = 1; }
+        else if (s.compare(pos, 5, "false") == 0)   { pos += 5; j.kind = Json::Bool; }
+        else if (s.compare(pos, 4, "null") == 0)    { pos += 4; }
+        else {
+            size_t used = 0;
+            try { j.num = std::stod(s.substr(pos, 32), &used); } catch (...) { fail("bad number"); }
+            pos += used; j.kind = Json::Number;
+        }
+        return j;
+    }
+
+    std::string string() {
+        if (pos >= s.size() || s[pos] != '"') fail("expected string");
+        std::string out;
+        for (++pos; pos < s.size() && s[pos] != '"'; ++pos) {
+            if (s[pos] == '\\' && pos + 1 < s.size()) ++pos;   // escapes kept literally
+            out += s[pos];
+        }
+        if (pos >= s.size()) fail("unterminated string");
+        ++pos;
+        return out;
+    }
+};
+
+//─── Bench results ──────────────────────────────────────────
+
+using Key = std::pair<std::string, size_t>;          // (op, n)
+
+std::map<Key, std::vector<double>> load(const std::string& path) {
+    std::ifstream in(path);
+    if (!in) throw std::runtime_error("cannot open " + path);
+    std::stringstream buf;
+    buf << in.rdbuf();
+    const Json root = JsonParser(buf.str()).parse();
+
+    std::map<Key, std::vector<double>> out;
+    for (const Json& r : root.at("results").arr) {
+        std::vector<double> samples;
+        for (const Json& v : r.at("samples_ns").arr) samples.push_back(v.num);
+        if (samples.empty()) samples.push_back(r.at("median_ns").num);
+        out[{r.at("op").str, size_t(r.at("n").num)}] = std::move(samples);
+    }
+    return out;
+}
+
+double median(std::vector<double> v) {
+    std::sort(v.begin(), v.end());
+    const size_t m = v.size() / 2;
+    return v.size() % 2 ? v[m] : 0.5 * (v[m - 1] + v[m]);
+}
+
+constexpr size_t kExactMax = 400;                    // na*nb up to which U is counted exactly
+
+/** P(U >= u) for U = #{(x, y) : x from a sample of na, y from nb, x < y}
+ *  when both samples come from one continuous distribution, by counting
+ *  the C(na+nb, nb) equally likely orderings (adding the largest value
+ *  from b raises U by the number of a values already placed). */
+double exact_u_greater(size_t na, size_t nb, double u) {
+    const size_t umax = na * nb;
+    std::vector<std::vector<double>> prev(nb + 1, std::vector<double>(umax + 1)), cur = prev;
+    for (size_t i = 0; i <= na; ++i) {
+        for (size_t j = 0; j <= nb; ++j) {
+            std::vector<double>& f = cur[j];
+            std::fill(f.begin(), f.end(), 0.0);
+            if (i == 0 && j == 0) { f[0] = 1; continue; }
+            if (i > 0) for (size_t k = 0; k <= umax; ++k) f[k] += prev[j][k];
+            if (j > 0) for (size_t k = i; k <= umax; ++k) f[k] += cur[j - 1][k - i];
+        }
+        std::swap(prev, cur);
+    }
+    double total = 0, tail = 0;
+    for (size_t k = 0; k <= umax; ++k) {
+        total += prev[nb][k];
+        if (double(k) >= u - 1e-9) tail += prev[nb][k];
+    }
+    return tail / total;
+}
+
+/// Smallest p-value any one-sided outcome can reach: 1 / C(na+nb, nb).
+double min_p(size_t na, size_t nb) {
+    double c = 1;
+    for (size_t k = 1; k <= nb; ++k) c = c * double(na + k) / double(k);
+    return 1 / c;
+}
+
+/** One-sided Mann-Whitney U: p-value for "samples of b tend to be larger
+ *  than a". Exact for small samples without ties, otherwise the normal
+ *  approximation with tie and continuity correction. */
+double mann_whitney_greater(const std::vector<double>& a, const std::vector<double>& b) {
+    const size_t na = a.size(), nb = b.size(), N = na + nb;
+    std::vector<std::pair<double, int>> all;
+    for (double x : a) all.push_back({x, 0});
+    for (double x : b) all.push_back({x, 1});
+    std::sort(all.begin(), all.end());
+
+    double rank_b = 0, ties = 0;
+    for (size_t i = 0; i < N;) {
+        size_t j = i;
+        while (j < N && all[j].first == all[i].first) ++j;
+        const double r = 0.5 * double(i + j + 1);    // average of ranks i+1..j
+        for (size_t k = i; k < j; ++k) if (all[k].second) rank_b += r;
+        const double t = double(j - i);
+        ties += t * t * t - t;
+        i = j;
+    }
+    const double u    = rank_b - double(nb) * double(nb + 1) / 2;
+    if (ties == 0 && na * nb <= kExactMax) return exact_u_greater(na, nb, u);
+    const double mu   = double(na) * double(nb) / 2;
+    const double var  = double(na) * double(nb) / 12 * (double(N + 1) - ties / (double(N) * double(N - 1)));
+    if (var <= 0) return u > mu ? 0.0 : 1.0;
+    const double z = (u - mu - 0.5) / std::sqrt(var);
+    return 0.5 * std::erfc(z / std::sqrt(2.0));
+}
+
+struct Options {
+    std::string                   base, cand;
+    double                        threshold = 0.05;
+    double                        alpha     = 0.01;
+    std::map<std::string, double> per_op;            // op → threshold override
+};
+
+Options parse_args(int argc, char** argv) {
+    Options o;
+    std::vector<std::string> files;
+    for (int i = 1; i < argc; ++i) {
+        std::string a = argv[i];
+        auto val = [&]() -> std::string {
+            if (i + 1 >= argc) throw std::invalid_argument("missing value for " + a);
+            return argv[++i];
+        };
+        if      (a == "--threshold") o.threshold = std::stod(val());
+        else if (a == "--alpha")     o.alpha     = std::stod(val());
+        else if (a == "--op") {
+            std::string v = val();
+            const size_t eq = v.find('=');
+            if (eq == std::string::npos) throw std::invalid_argument("--op expects name=threshold");
+            o.per_op[v.substr(0, eq)] = std::stod(v.substr(eq + 1));
+        }
+        else if (!a.empty() && a[0] == '-') throw std::invalid_argument("unknown option: " + a);
+        else files.push_back(a);
+    }
+    if (files.size() != 2) throw std::invalid_argument("usage: bench_compare BASE.json NEW.json [options]");
+    o.base = files[0];
+    o.cand = files[1];
+    return o;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    try {
+        const Options opt = parse_args(argc, argv);
+        const auto base = load(opt.base), cand = load(opt.cand);
+
+        size_t regressions = 0, insufficient = 0;
+        std::cout << std::left << std::setw(10) << "op" << std::right << std::setw(6) << "n"
+                  << std::setw(14) << "base_ns" << std::setw(14) << "new_ns" << std::setw(9) << "change"
+                  << std::setw(10) << "p" << "  verdict\n" << std::fixed;
+        for (const auto& [key, nb] : cand) {
+            auto it = base.find(key);
+            if (it == base.end()) {
+                std::cout << std::left << std::setw(10) << key.first << std::right << std::setw(6) << key.second
+                          << "  (not in baseline)\n";
+                continue;
+            }
+            const double mb = median(it->second), mn = median(nb);
+            const double change = mn / mb - 1.0;
+            const double p = mann_whitney_greater(it->second, nb);
+            auto th = opt.per_op.find(key.first);
+            const double limit = th != opt.per_op.end() ? th->second : opt.threshold;
+
+            const char* verdict = "ok";
+            if (min_p(it->second.size(), nb.size()) >= opt.alpha)        { verdict = "insufficient samples"; ++insufficient; }
+            else if (change > limit && p < opt.alpha)                          { verdict = "REGRESSION"; ++regressions; }
+            else if (change > limit)                                      verdict = "slower (not significant)";
+            else if (-change > limit && mann_whitney_greater(nb, it->second) < opt.alpha) verdict = "faster";
+
+            std::cout << std::left << std::setw(10) << key.first << std::right << std::setw(6) << key.second
+                      << std::setprecision(0) << std::setw(14) << mb << std::setw(14) << mn
+                      << std::setprecision(1) << std::setw(8) << change * 100 << '%'
+                      << std::setprecision(4) << std::setw(10) << p << "  " << verdict << '\n';
+        }
+        for (const auto& [key, nb] : base)
+            if (!cand.count(key))
+                std::cout << std::left << std::setw(10) << key.first << std::right << std::setw(6) << key.second
+                          << "  (missing from new run)\n";
+
+        std::cout << regressions << " regression(s)\n";
+        if (insufficient) {
+            std::cerr << "bench_compare: " << insufficient << " case(s) have too few samples to reach alpha "
+                      << opt.alpha << " (rerun bench with more --reps)\n";
+            return 2;
+        }
+        return regressions ? 1 : 0;
+    } catch (const std::exception& e) {
+        std::cerr << "bench_compare: " << e.what() << '\n';
+        return 2;
+    }
+}
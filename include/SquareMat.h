@@ -4,25 +4,61 @@
  #ifndef SQUARE_MAT_H
  #define SQUARE_MAT_H
  
+ #include <atomic>
+ #include <cassert>
  #include <cstddef>
+ #include <cstdio>
  #include <iostream>
+ #include <span>
  #include <stdexcept>
  #include <string>
+ #include "SquareMat_views.h"
+ 
+ // Define SQUAREMAT_NO_BOUNDS_CHECK (e.g. in release builds) to turn the
+ // throwing [][] bounds checks into debug-only asserts.
+ #ifdef SQUAREMAT_NO_BOUNDS_CHECK
+ #define SQUAREMAT_BOUNDS(ok, msg) assert((ok) && msg)
+ #else
+ #define SQUAREMAT_BOUNDS(ok, msg) do { if (!(ok)) throw std::invalid_argument(msg); } while (0)
+ #endif
  
  namespace mat {
  
+ enum class NpyType;   // SquareMat_formats.h
+ enum class NpyOrder;
+ enum class MMFormat;
+ enum class Trans;     // below
+ class Graph;          // SquareMat_graph.h
+ 
+ /// Sparsity pattern found by SquareMat::structure(); bandwidths count the
+ /// farthest non-zero below (lower) and above (upper) the diagonal.
+ struct Structure {
+     enum Kind { General, Diagonal, Upper, Lower, Banded };
+     Kind        kind;
+     std::size_t lower, upper;
+ };
+ 
  class SquareMat {
      std::size_t n;    // dimension (n×n)
-     double*    data;  // heap array of length n*n
+     double*    buf;   // heap array of length n*n (row-major)
+     std::atomic<std::size_t>* refs = nullptr; // COW mode: owners of buf; nullptr = private buffer
+     bool       leaked = false; // COW mode: a mutable pointer into buf was handed out, so never share it
  
      //─── Private helpers ──────────────────────────────────────
-     void   copy_from(const SquareMat& other);      // deep-copy
+     void   copy_from(const SquareMat& other);      // deep copy, or share if other is COW
+     void   release();                              // drop our reference to buf
+     void   unshare();                              // private copy of a shared buf
+     void   reshape(std::size_t dim);               // resize, keeping storage if dim==n
+     void   detach() { if (refs && refs->load(std::memory_order_acquire) != 1) unshare(); }
+     double* wbuf() { detach(); return buf; }        // buf, about to be written
+     double* leak() { detach(); leaked = refs != nullptr; return buf; } // buf, writable by the caller later
      double sum()          const;                   // sum of all elements
      double determinant_gauss() const;              // O(n³) determinant
+     double determinant_band(std::size_t kl, std::size_t ku) const; // O(n·kl·(kl+ku))
  
      // raw cell access
-     double&       cell(std::size_t r, std::size_t c)       { return data[r*n + c]; }
-     const double& cell(std::size_t r, std::size_t c) const { return data[r*n + c]; }
+     double&       cell(std::size_t r, std::size_t c)       { return wbuf()[r*n + c]; }
+     const double& cell(std::size_t r, std::size_t c) const { return buf[r*n + c]; }
  
  public:
      //─── Rule of Three ───────────────────────────────────────
@@ -30,12 +66,17 @@
      explicit SquareMat(std::size_t dim, double val = 0.0);
      /// from C-array
      SquareMat(std::size_t dim, const double* raw);
+     /// materialize a block view (copies)
+     explicit SquareMat(ConstBlockView v);
      SquareMat(const SquareMat&);                // copy ctor
      SquareMat& operator=(const SquareMat&);     // copy assign
      ~SquareMat();                                // destructor
  
      //─── Static factory ─────────────────────────────────────
-     /** Parse string "a b c, d e f, g h i" into a 3×3 matrix. */
+     /** Parse string "a b c, d e f, g h i" into a 3×3 matrix.
+      *  Single pass; dimension comes from the first row. A spec without
+      *  commas is read row-major and must hold a square count.
+      *  Throws invalid_argument naming the offending position. */
      static SquareMat from_string(const std::string& spec);
  
      //─── Element access via [][ ] with bounds-check ─────────
@@ -45,23 +86,67 @@
      public:
          Row(double* p, std::size_t l) : ptr(p), len(l) {}
          double&       operator[](std::size_t c) {
-             if (c >= len) throw std::invalid_argument("column index out of range");
+             SQUAREMAT_BOUNDS(c < len, "column index out of range");
              return ptr[c];
          }
          const double& operator[](std::size_t c) const {
-             if (c >= len) throw std::invalid_argument("column index out of range");
+             SQUAREMAT_BOUNDS(c < len, "column index out of range");
              return ptr[c];
          }
      };
      Row       operator[](std::size_t r) {
-         if (r >= n) throw std::invalid_argument("row index out of range");
-         return Row(data + r*n, n);
+         SQUAREMAT_BOUNDS(r < n, "row index out of range");
+         return Row(leak() + r*n, n);
      }
      const Row operator[](std::size_t r) const {
-         if (r >= n) throw std::invalid_argument("row index out of range");
-         return Row(data + r*n, n);
+         SQUAREMAT_BOUNDS(r < n, "row index out of range");
+         return Row(buf + r*n, n);
      }
+
+     //─── Unchecked fast path (caller guarantees r,c < n) ────
+     double*       data()       { return leak(); }        // row-major, n*n
+     const double* data() const { return buf; }
+     double&       at_unchecked(std::size_t r, std::size_t c)       { return leak()[r*n + c]; }
+     const double& at_unchecked(std::size_t r, std::size_t c) const { return buf[r*n + c]; }
+     double*       row_ptr(std::size_t r)       { return leak() + r*n; }
+     const double* row_ptr(std::size_t r) const { return buf + r*n; }
+     std::span<double>       row(std::size_t r)       { return {leak() + r*n, n}; }
+     std::span<const double> row(std::size_t r) const { return {buf + r*n, n}; }
+
+     //─── Iterators & range views (no copies) ────────────────
+     double*       begin()        { return leak(); }     // contiguous, row-major
+     double*       end()          { return leak() + n*n; }
+     const double* begin()  const { return buf; }
+     const double* end()    const { return buf + n*n; }
+     const double* cbegin() const { return buf; }
+     const double* cend()   const { return buf + n*n; }
+     RowRange<double>          rows()       { return {leak(), n}; }
+     RowRange<const double>    rows() const { return {buf, n}; }
+     StridedView<double>       col(std::size_t c)       { return {leak() + c, n, static_cast<std::ptrdiff_t>(n)}; }
+     StridedView<const double> col(std::size_t c) const { return {buf + c, n, static_cast<std::ptrdiff_t>(n)}; }
+     StridedView<double>       diag()       { return {leak(), n, static_cast<std::ptrdiff_t>(n + 1)}; }
+     StridedView<const double> diag() const { return {buf, n, static_cast<std::ptrdiff_t>(n + 1)}; }
+
+     //─── Block views (non-owning, on this buffer) ───────────
+     BlockView      view()       { return {leak(), n, n}; }
+     ConstBlockView view() const { return {buf, n, n}; }
+     operator ConstBlockView() const { return view(); }
+     /// size×size block with top-left (r0,c0); invalid_argument if out of range
+     BlockView      block(std::size_t r0, std::size_t c0, std::size_t size);
+     ConstBlockView block(std::size_t r0, std::size_t c0, std::size_t size) const;
  
+     //─── Copy-on-write mode ──────────────────────────────────
+     /** Switch to shared storage: copies of this matrix (and of those
+      *  copies) share the buffer via an atomic refcount until one of them
+      *  is written (compound ops, ++/--). A mutable accessor (non-const
+      *  [], data(), row_ptr, row, begin/end, rows/col/diag, view/block)
+      *  first gives this matrix a private buffer and then marks it
+      *  unshareable, since the returned pointer may be written later:
+      *  copies made from it are deep until the buffer is replaced. */
+     SquareMat& enable_cow();
+     bool cow()       const { return refs != nullptr; }
+     bool is_shared() const { return refs && refs->load(std::memory_order_acquire) > 1; }
+
      std::size_t size()  const { return n; }     // dimension
      double      total() const { return sum(); } // alias for tests
  
@@ -96,6 +181,11 @@
      SquareMat& operator--();      // pre-decrement
      SquareMat  operator--(int);   // post-decrement
  
+     //─── Structure (drives dispatch in *, ^ and !) ──────────
+     /** O(n²) worst case, usually far less: rows are scanned inward from
+      *  both ends and the scan stops once the matrix is clearly general. */
+     Structure structure() const;
+
      //─── Transpose & Determinant ────────────────────────────
      SquareMat operator~ () const; // transpose
      double    operator! () const; // determinant
@@ -111,10 +201,71 @@
      //─── I/O ─────────────────────────────────────────────────
      friend std::ostream& operator<<(std::ostream&, const SquareMat&);
      friend std::istream& operator>>(std::istream&, SquareMat&);
+     friend class MatReader;
+     friend SquareMat load_npy(const std::string&);
+     friend void      save_npy(const SquareMat&, const std::string&, NpyType, NpyOrder);
+     friend SquareMat load_mm(const std::string&);
+     friend void      save_mm(const SquareMat&, const std::string&, MMFormat);
+     friend void      save_compressed(const SquareMat&, const std::string&, std::size_t);
+     friend class CompressedMatFile;
+     friend class Graph;
+     friend void gemm(double, const SquareMat&, const SquareMat&, double, SquareMat&, Trans, Trans);
+     /// Fast text dump (same layout as <<): shortest round-trip values, chunked writes
+     void write_text(std::FILE* f) const;
+     void write_text(int fd)       const;
      /// Convenience print + newline
      void print(std::ostream& out = std::cout) const { out << *this << '\n'; }
  };
  
+ //─── Block-view arithmetic ──────────────────────────────────
+ // SquareMat converts to ConstBlockView, so either side may be a whole matrix.
+ SquareMat operator+(ConstBlockView, ConstBlockView);
+ SquareMat operator-(ConstBlockView, ConstBlockView);
+ SquareMat operator%(ConstBlockView, ConstBlockView);   // element-wise
+ SquareMat operator*(ConstBlockView, ConstBlockView);   // product
+ SquareMat operator*(ConstBlockView, double);
+ SquareMat operator~(ConstBlockView);                   // transpose
+ 
+ // In place on the destination's parent buffer (invalid_argument on size
+ // mismatch or on an output that partially overlaps an input).
+ void      assign   (BlockView out, ConstBlockView a);
+ void      add      (ConstBlockView a, ConstBlockView b, BlockView out);
+ void      sub      (ConstBlockView a, ConstBlockView b, BlockView out);
+ void      multiply (ConstBlockView a, ConstBlockView b, BlockView out); // out must not overlap a/b
+ void      transpose(ConstBlockView a, BlockView out);                   // out == a allowed
+ BlockView operator+=(BlockView dst, ConstBlockView a);
+ BlockView operator-=(BlockView dst, ConstBlockView a);
+ BlockView operator%=(BlockView dst, ConstBlockView a);
+ BlockView operator*=(BlockView dst, double s);
+
+ //─── GEMM ───────────────────────────────────────────────────
+ enum class Trans { No, Yes };
+
+ /** C = alpha·op(A)·op(B) + beta·C in C's existing storage (op(X) is X or Xᵀ).
+  *  Works row by row through an O(n) scratch, so C may alias A; an alias of B
+  *  (or of A with Trans::Yes) costs one copy of that operand. beta == 0
+  *  ignores C's old contents. Banded/triangular operands skip their zeros. */
+ void gemm(double alpha, const SquareMat& A, const SquareMat& B, double beta, SquareMat& C,
+           Trans ta = Trans::No, Trans tb = Trans::No);
+
+ /// Unevaluated alpha·op(A)·op(B), consumed by C += / -= without a temporary.
+ struct Product {
+     const SquareMat& a;
+     const SquareMat& b;
+     double alpha = 1.0;
+     Trans  ta    = Trans::No;
+     Trans  tb    = Trans::No;
+ };
+ inline Product prod(const SquareMat& A, const SquareMat& B,
+                     Trans ta = Trans::No, Trans tb = Trans::No) { return {A, B, 1.0, ta, tb}; }
+ inline Product operator*(double s, Product p) { p.alpha *= s; return p; }
+ inline SquareMat& operator+=(SquareMat& C, const Product& p) {
+     gemm(p.alpha, p.a, p.b, 1.0, C, p.ta, p.tb); return C;
+ }
+ inline SquareMat& operator-=(SquareMat& C, const Product& p) {
+     gemm(-p.alpha, p.a, p.b, 1.0, C, p.ta, p.tb); return C;
+ }
+ 
  } // namespace mat
  
  #endif // SQUARE_MAT_H
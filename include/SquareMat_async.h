@@ -0,0 +1,53 @@
+/*  Author: <Thelet.Shevach@gmail.com
+ *  SquareMat_async.h – non-blocking operators on the shared ThreadPool.
+ */
+ #ifndef SQUARE_MAT_ASYNC_H
+ #define SQUARE_MAT_ASYNC_H
+
+ #include "SquareMat.h"
+ #include <atomic>
+ #include <exception>
+ #include <functional>
+ #include <future>
+ #include <memory>
+ #include <stdexcept>
+
+ namespace mat {
+
+ /// Shared flag: copies observe the same cancel().
+ class CancelToken {
+     std::shared_ptr<std::atomic<bool>> flag = std::make_shared<std::atomic<bool>>(false);
+ public:
+     void cancel()    const { flag->store(true, std::memory_order_relaxed); }
+     bool cancelled() const { return flag->load(std::memory_order_relaxed); }
+     const std::atomic<bool>& state() const { return *flag; }
+ };
+
+ /// stored in the future of an operation whose token was cancelled
+ struct Cancelled : std::runtime_error {
+     Cancelled() : std::runtime_error("operation cancelled") {}
+ };
+
+ /// Completion callback, run on the worker before the future becomes ready:
+ /// `result` is null when `error` is set.
+ template <class T>
+ using Completion = std::function<void(const T* result, std::exception_ptr error)>;
+
+ /** Each call copies its operands (cheap for copy-on-write matrices), queues
+  *  the work on ThreadPool::instance() and returns at once. The token is
+  *  checked before starting, between blocks of 32 rows (products) or 16
+  *  pivots (elimination), and after the Cholesky attempt for symmetric
+  *  inputs; a cancelled job stops and yields Cancelled. Operands are never
+  *  modified, even when they share a copy-on-write buffer with the caller.
+  *  Exceptions such as size mismatch also arrive through the future. With
+  *  no pool workers the work runs inline. */
+ std::future<SquareMat> async_multiply(SquareMat A, SquareMat B, CancelToken tok = {},
+                                       Completion<SquareMat> done = {});
+ std::future<double>    async_det     (SquareMat A, CancelToken tok = {},
+                                       Completion<double> done = {});
+ std::future<SquareMat> async_pow     (SquareMat A, unsigned int p, CancelToken tok = {},
+                                       Completion<SquareMat> done = {});
+
+ } // namespace mat
+
+ #endif // SQUARE_MAT_ASYNC_H
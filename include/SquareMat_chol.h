@@ -0,0 +1,35 @@
+/*  Author: <Thelet.Shevach@gmail.com
+ *  SquareMat_chol.h – Cholesky factorization for symmetric positive definite matrices.
+ */
+ #ifndef SQUARE_MAT_CHOL_H
+ #define SQUARE_MAT_CHOL_H
+
+ #include "SquareMat.h"
+
+ namespace mat {
+
+ /** A = L·Lᵀ via a blocked right-looking factorization whose panel solve
+  *  and trailing update run on the shared ThreadPool. About n³/3 flops,
+  *  half of the pivoted elimination behind operator!. */
+ class Cholesky {
+     SquareMat L;      // lower triangle holds the factor, upper is zero
+ public:
+     /// invalid_argument if A is not symmetric positive definite
+     explicit Cholesky(const SquareMat& A);
+
+     /// cheap screen (exact symmetry, positive diagonal); O(n²)
+     static bool maybe_spd(const SquareMat& A);
+     /// full test: screen, then attempt the factorization
+     static bool is_spd(const SquareMat& A);
+
+     const SquareMat& factor() const { return L; }
+     std::size_t size()    const { return L.size(); }
+     double      det()     const;           // ∏ L(i,i)²
+     double      log_det() const;           // 2 Σ log L(i,i), no overflow
+     /// X with A·X = B (each column of B is a right-hand side)
+     SquareMat   solve(const SquareMat& B) const;
+ };
+
+ } // namespace mat
+
+ #endif // SQUARE_MAT_CHOL_H
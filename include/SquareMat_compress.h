@@ -0,0 +1,55 @@
+/*  Author: <Thelet.Shevach@gmail.com
+ *  SquareMat_compress.h – chunked compressed on-disk container (.sqmz).
+ */
+ #ifndef SQUARE_MAT_COMPRESS_H
+ #define SQUARE_MAT_COMPRESS_H
+
+ #include "SquareMat.h"
+ #include <cstddef>
+ #include <cstdint>
+ #include <string>
+ #include <vector>
+
+ namespace mat {
+
+ /** Layout: header, block index, then independent row blocks. Each block
+  *  is byte-shuffled (all first bytes of its doubles, then all second
+  *  bytes, ...) and LZ-compressed with a built-in LZ4-style coder; blocks
+  *  that do not shrink are stored raw. Blocks are (de)compressed in
+  *  parallel on the shared ThreadPool. */
+ void      save_compressed(const SquareMat& m, const std::string& path,
+                           std::size_t rows_per_block = 0);  // 0 = ~256 KiB blocks
+ SquareMat load_compressed(const std::string& path);
+
+ /// Random access into a .sqmz file: only blocks overlapping a request are decoded.
+ class CompressedMatFile {
+ public:
+     explicit CompressedMatFile(const std::string& path);
+     CompressedMatFile(const CompressedMatFile&)            = delete;
+     CompressedMatFile& operator=(const CompressedMatFile&) = delete;
+     ~CompressedMatFile();
+
+     std::size_t size()           const { return n; }
+     std::size_t rows_per_block() const { return block_rows; }
+     std::size_t compressed_bytes() const;
+
+     /// Decode rows [first, first+count) into out (count*size() doubles).
+     void      read_rows(std::size_t first, std::size_t count, double* out) const;
+     SquareMat load() const;
+
+ private:
+     struct Block { std::uint64_t offset, bytes; std::uint32_t method; };
+     int                fd;
+     std::size_t        n, block_rows;
+     std::vector<Block> blocks;
+ };
+
+ //─── Raw codec (exposed for reuse and testing) ──────────────
+ std::vector<unsigned char> lz_compress(const unsigned char* src, std::size_t len);
+ /// Throws invalid_argument unless src decodes to exactly out_len bytes.
+ void lz_decompress(const unsigned char* src, std::size_t len,
+                    unsigned char* out, std::size_t out_len);
+
+ } // namespace mat
+
+ #endif // SQUARE_MAT_COMPRESS_H
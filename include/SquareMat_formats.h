@@ -0,0 +1,34 @@
+/*  Author: <Thelet.Shevach@gmail.com
+ *  SquareMat_formats.h – NumPy .npy and MatrixMarket import/export.
+ */
+ #ifndef SQUARE_MAT_FORMATS_H
+ #define SQUARE_MAT_FORMATS_H
+
+ #include "SquareMat.h"
+ #include <string>
+
+ namespace mat {
+
+ enum class NpyType  { Float64, Float32 };
+ enum class NpyOrder { C, Fortran };
+ enum class MMFormat { Array, Coordinate };
+
+ //─── NumPy .npy (format versions 1.0–3.0) ───────────────────
+ /** Load an (n, n) '<f8' / '<f4' (or big-endian) array in C or Fortran
+  *  order. Float64 C-order data is read straight into the matrix buffer;
+  *  the other layouts are converted in place without a second buffer. */
+ SquareMat load_npy(const std::string& path);
+ void      save_npy(const SquareMat& m, const std::string& path,
+                    NpyType type = NpyType::Float64, NpyOrder order = NpyOrder::C);
+
+ //─── MatrixMarket (.mtx) ────────────────────────────────────
+ /** Reads real/integer/pattern data, array or coordinate, with general,
+  *  symmetric or skew-symmetric storage. Matrix must be square. */
+ SquareMat load_mm(const std::string& path);
+ /// Array writes every entry column-major; Coordinate writes non-zeros only
+ void      save_mm(const SquareMat& m, const std::string& path,
+                   MMFormat fmt = MMFormat::Array);
+
+ } // namespace mat
+
+ #endif // SQUARE_MAT_FORMATS_H
@@ -0,0 +1,133 @@
+/*  Author: <Thelet.Shevach@gmail.com
+ *  SquareMat_graph.h – deferred expression graphs evaluated concurrently.
+ */
+ #ifndef SQUARE_MAT_GRAPH_H
+ #define SQUARE_MAT_GRAPH_H
+
+ #include "SquareMat.h"
+ #include <cstddef>
+ #include <deque>
+ #include <memory>
+ #include <vector>
+
+ namespace mat {
+
+ class Graph;
+ class ThreadPool;
+
+ /// Matrix-valued node of a Graph; operators build new nodes, eval() computes.
+ class Expr {
+     Graph*      g;
+     std::size_t id;
+     Expr(Graph* graph, std::size_t node) : g(graph), id(node) {}
+     friend class Graph;
+ public:
+     std::size_t size() const;
+     SquareMat   eval() const;     // computes (once); the copy shares the graph's buffer
+ };
+
+ /// Scalar-valued node (determinants and arithmetic on them).
+ class Scalar {
+     Graph*      g;
+     std::size_t id;
+     Scalar(Graph* graph, std::size_t node) : g(graph), id(node) {}
+     friend class Graph;
+ public:
+     double eval() const;
+ };
+
+ /** Records SquareMat operations instead of running them. Evaluating a node
+  *  runs every node it depends on that is not yet known: nodes whose inputs
+  *  are ready are submitted to the ThreadPool together, so independent
+  *  branches such as the two products in `!(A*B) + !(C*D)` overlap. `^` is
+  *  expanded into square-and-multiply nodes at build time. eval() joins its
+  *  nodes as a TaskGroup, so it may be called from inside a pool task.
+  *
+  *  Intermediate buffers return to a per-graph free list once their last
+  *  consumer has run and are reused by later nodes of the same size; only
+  *  inputs and evaluated nodes keep their values, so a released intermediate
+  *  is recomputed if a later eval() needs it again. Size mismatches throw
+  *  std::invalid_argument when the node is built; kernel errors surface from
+  *  eval(). A Graph must outlive its handles and, like a SquareMat, is
+  *  built and evaluated from one thread at a time. */
+ class Graph {
+ public:
+     struct Stats {
+         std::size_t nodes_run        = 0;   // nodes computed over all evaluations
+         std::size_t buffers_created  = 0;   // n×n buffers allocated for results
+         std::size_t buffers_reused   = 0;   // results written into a released buffer
+     };
+
+     Graph() = default;
+     /// run nodes on `on` instead of ThreadPool::instance()
+     explicit Graph(ThreadPool& on) : pool(&on) {}
+     Graph(const Graph&)            = delete;
+     Graph& operator=(const Graph&) = delete;
+
+     Expr   input(const SquareMat& m);    // snapshot (O(1) if m is copy-on-write)
+     Scalar constant(double v);
+
+     /// evaluate several nodes in one pass (shared subexpressions run once)
+     void eval(const std::vector<Expr>& ms, const std::vector<Scalar>& ss = {});
+
+     Stats stats() const { return st; }
+
+     friend Expr   operator+(Expr a, Expr b);
+     friend Expr   operator-(Expr a, Expr b);
+     friend Expr   operator*(Expr a, Expr b);
+     friend Expr   operator*(Expr a, double s);
+     friend Expr   operator^(Expr a, unsigned int p);
+     friend Expr   operator~(Expr a);
+     friend Scalar operator!(Expr a);
+     friend Scalar operator+(Scalar a, Scalar b);
+     friend Scalar operator-(Scalar a, Scalar b);
+     friend Scalar operator*(Scalar a, Scalar b);
+     friend Scalar operator/(Scalar a, Scalar b);
+     friend class Expr;
+     friend class Scalar;
+
+ private:
+     enum class Op { Input, Add, Sub, Mul, Scale, Transpose, Det,
+                     Const, SAdd, SSub, SMul, SDiv };
+     struct Node {
+         Op                       op;
+         std::size_t              a = 0, b = 0;    // operand node ids
+         std::size_t              n = 0;           // dimension (matrix nodes)
+         double                   s = 0;           // scale factor / scalar value
+         std::unique_ptr<SquareMat> m;             // matrix value while held
+         bool                     known  = false;  // m / s hold the value
+         bool                     pinned = false;  // input or evaluated: never released
+         explicit Node(Op o) : op(o) {}
+     };
+
+     std::deque<Node>       nodes;     // stable addresses while the graph grows
+     std::vector<std::unique_ptr<SquareMat>> spare;   // released buffers
+     Stats                  st;
+     ThreadPool*            pool = nullptr;   // null: the shared pool
+
+     std::size_t   add_node(Node nd);
+     static Expr   matrix(Op op, Expr a, Expr b, double s = 0);
+     static Scalar scalar(Op op, Scalar a, Scalar b);
+     static Scalar det_of(Expr a);
+     static Expr   pow_of(Expr a, unsigned int p);
+     void          run(const std::vector<std::size_t>& targets);
+     void          compute(Node& nd, SquareMat* out);
+ };
+
+ Expr   operator+(Expr a, Expr b);
+ Expr   operator-(Expr a, Expr b);
+ Expr   operator*(Expr a, Expr b);
+ Expr   operator*(Expr a, double s);
+ inline Expr operator*(double s, Expr a) { return a * s; }
+ Expr   operator^(Expr a, unsigned int p);   // square-and-multiply nodes
+ Expr   operator~(Expr a);
+ Scalar operator!(Expr a);                   // determinant node
+ inline Scalar det(Expr a) { return !a; }
+ Scalar operator+(Scalar a, Scalar b);
+ Scalar operator-(Scalar a, Scalar b);
+ Scalar operator*(Scalar a, Scalar b);
+ Scalar operator/(Scalar a, Scalar b);
+
+ } // namespace mat
+
+ #endif // SQUARE_MAT_GRAPH_H
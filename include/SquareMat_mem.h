@@ -0,0 +1,53 @@
+/*  Author: <Thelet.Shevach@gmail.com
+ *  SquareMat_mem.h – opt-in allocation telemetry for matrix and vector buffers.
+ */
+ #ifndef SQUARE_MAT_MEM_H
+ #define SQUARE_MAT_MEM_H
+
+ #include <cstddef>
+ #include <cstdint>
+ #include <iosfwd>
+ #include <string>
+ #include <vector>
+
+ namespace mat {
+ namespace mem {
+
+ /** Buffers allocated at one site (ctor, copy, unshare, reshape, scratch, …)
+  *  while inside one operator ("-" outside any instrumented operator, e.g.
+  *  the copy made by `C = A + B`). Only buffers born while recording count. */
+ struct Entry {
+     std::string   op;
+     std::string   site;
+     std::uint64_t allocs      = 0;
+     std::uint64_t frees       = 0;
+     std::uint64_t bytes       = 0;      // total allocated
+     std::int64_t  live_bytes  = 0;
+     std::int64_t  peak_bytes  = 0;      // peak of live_bytes for this entry
+     std::uint64_t lifetime_ns = 0;      // summed over freed buffers
+     std::uint64_t max_lifetime_ns = 0;
+ };
+
+ struct Totals {
+     std::uint64_t allocs     = 0;
+     std::uint64_t frees      = 0;
+     std::uint64_t bytes      = 0;
+     std::int64_t  live_bytes = 0;
+     std::int64_t  peak_bytes = 0;       // process-wide high-water mark
+ };
+
+ /// Start/stop recording. Also switched on by SQUAREMAT_MEM at load time:
+ /// "1" prints the report to stderr at exit, any other value is a file path.
+ void enable(bool on = true);
+ bool enabled();
+
+ std::vector<Entry> snapshot();          // sorted by op, then site
+ Totals             totals();
+ /// zero all counters; buffers still alive from before are no longer tracked
+ void               reset();
+ void               report(std::ostream& out);
+
+ } // namespace mem
+ } // namespace mat
+
+ #endif // SQUARE_MAT_MEM_H
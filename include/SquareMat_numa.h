@@ -0,0 +1,47 @@
+/*  Author: <Thelet.Shevach@gmail.com
+ *  SquareMat_numa.h – NUMA placement of large buffers and worker pinning.
+ *  Linux system calls only; elsewhere (or when the kernel refuses) every
+ *  call degrades to a no-op that reports false.
+ */
+ #ifndef SQUARE_MAT_NUMA_H
+ #define SQUARE_MAT_NUMA_H
+
+ #include <cstddef>
+
+ namespace mat {
+ namespace numa {
+
+ /** Where pages of large matrix buffers (≥ kMinBytes) are placed:
+  *  FirstTouch – the kernel default; constructors fill rows in parallel with
+  *               the same row split as operator*, so pages land on the nodes
+  *               of the workers that later read them.
+  *  Interleave – pages are spread round-robin over all online nodes
+  *               (mbind MPOL_INTERLEAVE), for data every core reads.
+  *  $SQUAREMAT_NUMA=interleave selects Interleave at start-up. */
+ enum class Placement { FirstTouch, Interleave };
+
+ constexpr std::size_t kMinBytes = std::size_t(1) << 21;   // 2 MiB (n ≥ 512)
+
+ void      set_placement(Placement p);   // affects buffers allocated afterwards
+ Placement placement();
+
+ /// online NUMA nodes (1 when the topology is unknown)
+ std::size_t nodes();
+
+ /// interleave the whole pages of [p, p+bytes) over all online nodes,
+ /// migrating pages that were already touched; false if refused
+ bool interleave(void* p, std::size_t bytes);
+
+ /// node holding the page of p (touching it if unmapped); -1 if unknown
+ int node_of(const void* p);
+
+ /** Pin the calling thread to one CPU: slot k walks the allowed CPUs
+  *  round-robin across nodes (k=0 → node 0, k=1 → node 1, …) so a pool
+  *  spreads evenly over the sockets. False if refused. ThreadPool workers
+  *  pin themselves this way when $SQUAREMAT_PIN=1. */
+ bool pin_thread(std::size_t k);
+
+ } // namespace numa
+ } // namespace mat
+
+ #endif // SQUARE_MAT_NUMA_H
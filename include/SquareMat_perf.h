@@ -0,0 +1,49 @@
+/*  Author: <Thelet.Shevach@gmail.com
+ *  SquareMat_perf.h – opt-in hardware counters around the library kernels.
+ */
+ #ifndef SQUARE_MAT_PERF_H
+ #define SQUARE_MAT_PERF_H
+
+ #include <cstddef>
+ #include <cstdint>
+ #include <iosfwd>
+ #include <string>
+ #include <vector>
+
+ namespace mat {
+ namespace perf {
+
+ /** Totals for one (operator, size class). Counters come from
+  *  perf_event_open on the calling thread plus, for parallel kernels, each
+  *  pool worker's own counter group around the tasks forked by that call;
+  *  `hw` is false when the kernel refused the events on any of them, in
+  *  which case only calls and wall time are recorded. */
+ struct Entry {
+     std::string   op;
+     std::size_t   size_class;      // smallest power of two >= n
+     std::uint64_t calls          = 0;
+     std::uint64_t ns             = 0;
+     std::uint64_t cycles         = 0;
+     std::uint64_t instructions   = 0;
+     std::uint64_t l1d_misses     = 0;
+     std::uint64_t llc_misses     = 0;
+     std::uint64_t branch_misses  = 0;
+     bool          hw             = false;
+ };
+
+ /// Start/stop recording. Also switched on by SQUAREMAT_PERF at load time:
+ /// "1" prints the report to stderr at exit, any other value is a file path.
+ void enable(bool on = true);
+ bool enabled();
+ /// true if this thread could open the hardware counters
+ bool available();
+
+ std::vector<Entry> snapshot();     // sorted by op, then size class
+ void               reset();
+ /// table with per-call cycles, IPC, and misses per 1000 instructions
+ void               report(std::ostream& out);
+
+ } // namespace perf
+ } // namespace mat
+
+ #endif // SQUARE_MAT_PERF_H
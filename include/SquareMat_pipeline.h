@@ -0,0 +1,235 @@
+/*  Author: <Thelet.Shevach@gmail.com
+ *  SquareMat_pipeline.h – coroutine stages joined by bounded channels.
+ */
+ #ifndef SQUARE_MAT_PIPELINE_H
+ #define SQUARE_MAT_PIPELINE_H
+
+ #include "SquareMat.h"
+ #include "SquareMat_stream.h"
+ #include <condition_variable>
+ #include <coroutine>
+ #include <cstddef>
+ #include <deque>
+ #include <exception>
+ #include <mutex>
+ #include <optional>
+ #include <stdexcept>
+ #include <utility>
+ #include <vector>
+
+ namespace mat {
+
+ class ThreadPool;
+
+ namespace detail {
+ /// resume h as a task of the running Pipeline when called from one of its
+ /// stages, else on the shared ThreadPool (inline when it has no workers)
+ void schedule(std::coroutine_handle<> h);
+ }
+
+ /** Bounded MPMC queue for coroutines: `co_await ch.push(v)` suspends while
+  *  the channel is full and `co_await ch.pop()` while it is empty, so a slow
+  *  stage throttles the ones feeding it. Suspended stages hold no thread;
+  *  they are resumed on the pool. `producers` stages must each call close()
+  *  before readers see the end; abort() ends it at once for everyone. */
+ template <class T>
+ class Channel {
+ public:
+     explicit Channel(std::size_t capacity = 4, std::size_t producers = 1)
+      : cap(capacity), open_producers(producers) {
+         if (cap == 0 || producers == 0) throw std::invalid_argument("capacity and producers must be >0");
+     }
+     Channel(const Channel&)            = delete;
+     Channel& operator=(const Channel&) = delete;
+
+     class PushAwaiter {
+         Channel&                ch;
+         T                       value;
+         bool                    ok = false;
+         std::coroutine_handle<> h;
+         friend class Channel;
+     public:
+         PushAwaiter(Channel& c, T v) : ch(c), value(std::move(v)) {}
+         bool await_ready() const noexcept { return false; }
+         bool await_suspend(std::coroutine_handle<> self) { h = self; return ch.suspend_push(*this); }
+         /// false if the channel was closed or aborted (value dropped)
+         bool await_resume() const noexcept { return ok; }
+     };
+
+     class PopAwaiter {
+         Channel&                ch;
+         std::optional<T>        item;
+         std::coroutine_handle<> h;
+         friend class Channel;
+     public:
+         explicit PopAwaiter(Channel& c) : ch(c) {}
+         bool await_ready() const noexcept { return false; }
+         bool await_suspend(std::coroutine_handle<> self) { h = self; return ch.suspend_pop(*this); }
+         /// nullopt once the channel is closed and drained
+         std::optional<T> await_resume() { return std::move(item); }
+     };
+
+     PushAwaiter push(T v) { return PushAwaiter(*this, std::move(v)); }
+     PopAwaiter  pop()     { return PopAwaiter(*this); }
+     void close() { finish(false); }   // one producer is done
+     void abort() { finish(true); }    // end now, dropping queued items
+
+ private:
+     std::mutex                mtx;
+     std::deque<T>             items;
+     std::deque<PushAwaiter*>  pushers;    // waiting for room
+     std::deque<PopAwaiter*>   poppers;    // waiting for an item
+     std::size_t               cap;
+     std::size_t               open_producers;
+     bool                      closed = false;
+
+     bool suspend_push(PushAwaiter& w) {
+         std::coroutine_handle<> wake;
+         {
+             std::lock_guard<std::mutex> lk(mtx);
+             if (closed) return false;
+             w.ok = true;
+             if (!poppers.empty()) {
+                 PopAwaiter* p = poppers.front();
+                 poppers.pop_front();
+                 p->item = std::move(w.value);
+                 wake = p->h;
+             } else if (items.size() < cap) {
+                 items.push_back(std::move(w.value));
+             } else {
+                 pushers.push_back(&w);
+                 return true;
+             }
+         }
+         if (wake) detail::schedule(wake);
+         return false;
+     }
+
+     bool suspend_pop(PopAwaiter& w) {
+         std::coroutine_handle<> wake;
+         {
+             std::lock_guard<std::mutex> lk(mtx);
+             if (!items.empty()) {
+                 w.item = std::move(items.front());
+                 items.pop_front();
+                 if (!pushers.empty()) {            // room again: admit one waiting pusher
+                     PushAwaiter* p = pushers.front();
+                     pushers.pop_front();
+                     items.push_back(std::move(p->value));
+                     wake = p->h;
+                 }
+             } else if (!closed) {
+                 poppers.push_back(&w);
+                 return true;
+             }
+         }
+         if (wake) detail::schedule(wake);
+         return false;
+     }
+
+     void finish(bool now) {
+         std::vector<std::coroutine_handle<>> wake;
+         {
+             std::lock_guard<std::mutex> lk(mtx);
+             if (closed) return;
+             if (!now && --open_producers > 0) return;
+             closed = true;
+             if (now) items.clear();
+             for (PopAwaiter* p : poppers)  wake.push_back(p->h);
+             for (PushAwaiter* p : pushers) { p->ok = false; wake.push_back(p->h); }
+             poppers.clear();
+             pushers.clear();
+         }
+         for (auto h : wake) detail::schedule(h);
+     }
+ };
+
+ class Pipeline;
+
+ /// Coroutine for one pipeline stage; it starts when Pipeline::run() schedules it.
+ class Task {
+ public:
+     struct promise_type {
+         Pipeline*          owner = nullptr;
+         std::exception_ptr error;
+
+         Task get_return_object() { return Task(std::coroutine_handle<promise_type>::from_promise(*this)); }
+         std::suspend_always initial_suspend() noexcept { return {}; }
+         std::suspend_never  final_suspend() noexcept;     // reports to the owner, frees the frame
+         void return_void() noexcept {}
+         void unhandled_exception() noexcept { error = std::current_exception(); }
+     };
+
+     Task(Task&& o) noexcept : h(std::exchange(o.h, {})) {}
+     Task& operator=(Task&&) = delete;
+     Task(const Task&)       = delete;
+     ~Task() { if (h) h.destroy(); }   // never started
+
+ private:
+     std::coroutine_handle<promise_type> h;
+     explicit Task(std::coroutine_handle<promise_type> handle) : h(handle) {}
+     friend class Pipeline;
+ };
+
+ /** Owns a set of stages; run() starts them all on the ThreadPool and returns
+  *  once every stage has, then rethrows the first stage error. Each resumed
+  *  step is a task of one TaskGroup that run() joins, so the calling thread
+  *  runs steps while it waits and run() may be called from a pool task.
+  *  Stages must close (or abort) their output channels or run() never ends;
+  *  the stage helpers below do so, also when they throw. */
+ class Pipeline {
+ public:
+     Pipeline() = default;
+     /// run stages on `on` instead of ThreadPool::instance()
+     explicit Pipeline(ThreadPool& on) : pool(&on) {}
+
+     Pipeline& add(Task t) { stages.push_back(std::move(t)); return *this; }
+     void run();
+
+ private:
+     std::vector<Task>       stages;
+     ThreadPool*             pool = nullptr;   // null: the shared pool
+     std::mutex              mtx;
+     std::condition_variable cv;
+     std::size_t             remaining = 0;
+     std::exception_ptr      error;
+
+     void stage_done(std::exception_ptr e) noexcept;
+     friend struct Task::promise_type;
+ };
+
+ //─── Stage helpers ──────────────────────────────────────────
+
+ /// every matrix from `in` into `out` (blocking reads run on a pool worker)
+ Task source(MatReader& in, Channel<SquareMat>& out);
+
+ /** out ← f(item) for each item of `in`. Several copies may share both
+  *  channels to run f in parallel (give `out` that many producers); the
+  *  output order is then not preserved. */
+ template <class In, class Out, class F>
+ Task stage(Channel<In>& in, Channel<Out>& out, F f) {
+     try {
+         while (std::optional<In> v = co_await in.pop())
+             if (!co_await out.push(f(std::move(*v)))) { in.abort(); break; }
+     } catch (...) {
+         in.abort();
+         out.abort();
+         throw;
+     }
+     out.close();
+ }
+
+ /// f(item) for each item of `in`
+ template <class In, class F>
+ Task sink(Channel<In>& in, F f) {
+     try {
+         while (std::optional<In> v = co_await in.pop()) f(std::move(*v));
+     } catch (...) {
+         in.abort();
+         throw;
+     }
+ }
+
+ } // namespace mat
+
+ #endif // SQUARE_MAT_PIPELINE_H
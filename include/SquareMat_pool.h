@@ -0,0 +1,144 @@
+/*  Author: <Thelet.Shevach@gmail.com
+ *  SquareMat_pool.h – shared work-stealing pool used by the parallel kernels.
+ */
+ #ifndef SQUARE_MAT_POOL_H
+ #define SQUARE_MAT_POOL_H
+
+ #include <atomic>
+ #include <condition_variable>
+ #include <cstddef>
+ #include <deque>
+ #include <exception>
+ #include <functional>
+ #include <memory>
+ #include <mutex>
+ #include <thread>
+ #include <utility>
+ #include <vector>
+
+ namespace mat {
+
+ class TaskGroup;
+
+ /** Each worker owns a deque: tasks it spawns are pushed and popped at the
+  *  back (newest first, still hot in cache) while idle workers steal from
+  *  the front (oldest, typically the largest pieces of a recursive split).
+  *  Tasks from threads outside the pool go to a shared queue. Every queued
+  *  task remembers the TaskGroup that forked it (none for submit()), so a
+  *  joining thread only helps with its own group's work. */
+ class ThreadPool {
+ public:
+     /** Process-wide pool; size from $SQUAREMAT_THREADS, else the core count;
+      *  workers are pinned when $SQUAREMAT_PIN=1. */
+     static ThreadPool& instance();
+
+     /// pin: worker i stays on the CPU numa::pin_thread(i) picks
+     explicit ThreadPool(std::size_t threads, bool pin = false);
+     ThreadPool(const ThreadPool&)            = delete;
+     ThreadPool& operator=(const ThreadPool&) = delete;
+     ~ThreadPool();
+
+     /// worker count (the calling thread is not counted)
+     std::size_t size() const { return workers.size(); }
+
+     /// Fire-and-forget task; runs inline when the pool has no workers.
+     void submit(std::function<void()> task);
+
+     /** Split [begin,end) into chunks of `grain` and call body(lo,hi) on
+      *  each. The range is halved recursively and one half forked, so idle
+      *  workers steal big pieces and uneven chunks balance out. The caller
+      *  runs chunks while it waits, so nested calls from a worker cannot
+      *  deadlock. The first exception thrown is rethrown. */
+     void parallel_for(std::size_t begin, std::size_t end, std::size_t grain,
+                       const std::function<void(std::size_t, std::size_t)>& body);
+
+     /** Same over the tile [r0,r1)×[c0,c1): the longer side is halved until
+      *  both are at most `grain`, giving cache-oblivious tiles for
+      *  body(r0,r1,c0,c1). */
+     void parallel_for_2d(std::size_t r0, std::size_t r1, std::size_t c0, std::size_t c1,
+                          std::size_t grain,
+                          const std::function<void(std::size_t, std::size_t,
+                                                   std::size_t, std::size_t)>& body);
+
+ private:
+     struct Task {
+         std::function<void()> fn;
+         TaskGroup*            group;   // forking group; null for submit()
+     };
+     struct Deque {
+         std::mutex       mtx;
+         std::deque<Task> tasks;
+     };
+
+     std::vector<std::thread>            workers;
+     std::vector<std::unique_ptr<Deque>> local;     // one per worker
+     std::deque<Task>                    queue;     // from outside the pool
+     std::mutex                          mtx;
+     std::condition_variable             cv;
+     std::atomic<std::size_t>            queued{0}; // tasks in all queues
+     std::atomic<std::size_t>            victim{0}; // steal start for outside threads
+     bool                                stopping = false;
+
+     void push(std::function<void()> task, TaskGroup* group);
+     /// run one queued task of `only` or a group nested in it (any task when
+     /// null); false if none found
+     bool run_one(const TaskGroup* only);
+     void worker_loop(std::size_t self, bool pin);
+     friend class TaskGroup;
+ };
+
+ /** Fork/join: run() forks a task onto the pool and wait() joins them all,
+  *  executing queued tasks instead of blocking while forked work is still
+  *  pending. Only tasks of this group, or of groups created inside its
+  *  tasks, are run by wait(): unrelated submit() jobs and outer groups' work
+  *  stay with the workers. wait() rethrows the first exception; the
+  *  destructor waits but swallows it. */
+ class TaskGroup {
+ public:
+     explicit TaskGroup(ThreadPool& pool = ThreadPool::instance());
+     TaskGroup(const TaskGroup&)            = delete;
+     TaskGroup& operator=(const TaskGroup&) = delete;
+     ~TaskGroup();
+
+     void run(std::function<void()> task);
+     void wait();
+
+ private:
+     ThreadPool&              pool;
+     const TaskGroup*         parent;    // group of the task running at creation
+     std::atomic<std::size_t> pending{0};
+     std::mutex               mtx;
+     std::condition_variable  cv;
+     std::exception_ptr       error;
+
+     void fail(std::exception_ptr e);
+     bool within(const TaskGroup* g) const;   // this is g or nested in it
+     friend class ThreadPool;
+ };
+
+ /// parallel_for on the shared pool
+ inline void parallel_for(std::size_t begin, std::size_t end, std::size_t grain,
+                          const std::function<void(std::size_t, std::size_t)>& body) {
+     ThreadPool::instance().parallel_for(begin, end, grain, body);
+ }
+
+ /// parallel_for_2d on the shared pool
+ inline void parallel_for_2d(std::size_t r0, std::size_t r1, std::size_t c0, std::size_t c1,
+                             std::size_t grain,
+                             const std::function<void(std::size_t, std::size_t,
+                                                      std::size_t, std::size_t)>& body) {
+     ThreadPool::instance().parallel_for_2d(r0, r1, c0, c1, grain, body);
+ }
+
+ /// f() and g() in parallel on the shared pool (g forked, f on the caller)
+ template <class F, class G>
+ void fork_join(F&& f, G&& g) {
+     TaskGroup tg;
+     tg.run(std::function<void()>(std::forward<G>(g)));
+     f();          // if f throws, ~TaskGroup still joins g
+     tg.wait();
+ }
+
+ } // namespace mat
+
+ #endif // SQUARE_MAT_POOL_H
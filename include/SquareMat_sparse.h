@@ -0,0 +1,68 @@
+/*  Author: <Thelet.Shevach@gmail.com
+ *  SquareMat_sparse.h – compressed sparse row (CSR) square matrix.
+ */
+ #ifndef SQUARE_MAT_SPARSE_H
+ #define SQUARE_MAT_SPARSE_H
+
+ #include "SquareMat.h"
+ #include <cstddef>
+ #include <vector>
+
+ namespace mat {
+
+ /** n×n sparse matrix in CSR form (column indices sorted within each row).
+  *  A CSC copy can be built on demand; it makes transpose O(nnz).
+  *  Products run row-parallel on the shared ThreadPool. */
+ class SparseSquareMat {
+ public:
+     struct Triplet { std::size_t row, col; double val; };
+
+     /// all-zero n×n matrix
+     explicit SparseSquareMat(std::size_t dim);
+     /// keep entries with |a(i,j)| > drop_tol
+     explicit SparseSquareMat(const SquareMat& m, double drop_tol = 0.0);
+     /// duplicates are summed; invalid_argument on out-of-range indices
+     static SparseSquareMat from_triplets(std::size_t dim, const std::vector<Triplet>& t);
+     static SparseSquareMat identity(std::size_t dim);
+
+     std::size_t size()    const { return n; }
+     std::size_t nnz()     const { return vals.size(); }
+     double      density() const { return double(nnz()) / (double(n) * double(n)); }
+     double      operator()(std::size_t r, std::size_t c) const;  // binary search in row r
+     SquareMat   to_dense() const;
+
+     //─── Raw CSR arrays ─────────────────────────────────────
+     const std::vector<std::size_t>& row_offsets() const { return rowp; }  // n+1
+     const std::vector<std::size_t>& col_indices() const { return cols; }
+     const std::vector<double>&      values()      const { return vals; }
+
+     //─── Optional CSC copy ──────────────────────────────────
+     void build_csc();
+     bool has_csc()  const { return !csc_colp.empty(); }
+     void drop_csc();
+
+     //─── Arithmetic ─────────────────────────────────────────
+     SparseSquareMat operator~() const;                         // transpose
+     SparseSquareMat operator+(const SparseSquareMat&) const;
+     SparseSquareMat operator-(const SparseSquareMat&) const;
+     SparseSquareMat operator%(const SparseSquareMat&) const;   // element-wise
+     SparseSquareMat operator*(double)                 const;
+     SparseSquareMat operator*(const SparseSquareMat&) const;   // SpGEMM
+     SquareMat       operator*(const SquareMat&)       const;   // sparse × dense
+     friend SquareMat operator*(const SquareMat&, const SparseSquareMat&); // dense × sparse
+     SparseSquareMat operator^(unsigned int p)         const;   // power by squaring
+
+ private:
+     std::size_t              n;
+     std::vector<std::size_t> rowp, cols;
+     std::vector<double>      vals;
+     std::vector<std::size_t> csc_colp, csc_rows;               // empty unless built
+     std::vector<double>      csc_vals;
+
+     template <class Op>
+     SparseSquareMat merge(const SparseSquareMat& o, Op op, bool intersect) const;
+ };
+
+ } // namespace mat
+
+ #endif // SQUARE_MAT_SPARSE_H
@@ -0,0 +1,78 @@
+/*  Author: <Thelet.Shevach@gmail.com
+ *  SquareMat_stream.h – streaming reader for back-to-back matrices.
+ */
+ #ifndef SQUARE_MAT_STREAM_H
+ #define SQUARE_MAT_STREAM_H
+
+ #include "SquareMat.h"
+ #include <cstddef>
+ #include <cstdio>
+ #include <iosfwd>
+ #include <iterator>
+ #include <vector>
+
+ namespace mat {
+
+ /** Pulls matrices in operator>> layout ("n v00 v01 ...") one after another
+  *  from an istream, FILE* or fd through one reusable read buffer.
+  *  The source is not owned and is read ahead, so do not mix other reads. */
+ class MatReader {
+ public:
+     explicit MatReader(std::istream& in, std::size_t buf_size = 1 << 16);
+     explicit MatReader(std::FILE* f,     std::size_t buf_size = 1 << 16);
+     explicit MatReader(int fd,           std::size_t buf_size = 1 << 16);
+     MatReader(const MatReader&)            = delete;
+     MatReader& operator=(const MatReader&) = delete;
+     ~MatReader();
+
+     /** Read the next matrix into m, reusing m's storage when the size
+      *  matches. Returns false on clean end of input; throws
+      *  invalid_argument on malformed or truncated data, leaving m as it
+      *  was (values are parsed into a scratch buffer first). */
+     bool next(SquareMat& m);
+
+     std::size_t count() const { return matrices; } // matrices read so far
+
+     //─── Input-iterator adaptor (for range-for) ─────────────
+     class iterator {
+         MatReader* rd;
+     public:
+         using iterator_category = std::input_iterator_tag;
+         using value_type        = SquareMat;
+         using difference_type   = std::ptrdiff_t;
+         using pointer           = const SquareMat*;
+         using reference         = const SquareMat&;
+
+         explicit iterator(MatReader* r = nullptr) : rd(r) {}
+         reference operator*()  const { return rd->cur; }
+         pointer   operator->() const { return &rd->cur; }
+         iterator& operator++() { if (!rd->next(rd->cur)) rd = nullptr; return *this; }
+         bool operator==(const iterator& o) const { return rd == o.rd; }
+         bool operator!=(const iterator& o) const { return rd != o.rd; }
+     };
+     /// begin() pulls the first matrix; each ++ overwrites it in place
+     iterator begin() { return next(cur) ? iterator(this) : iterator(); }
+     iterator end()   { return iterator(); }
+
+ private:
+     enum class Src { Stream, File, Fd };
+     Src           kind;
+     std::istream* in  = nullptr;
+     std::FILE*    f   = nullptr;
+     int           fd  = -1;
+
+     char*       buf;
+     std::size_t cap;
+     std::size_t pos = 0, len = 0;
+     bool        eof = false;
+     std::size_t matrices = 0;
+     SquareMat   cur{1};             // backing matrix for the iterator
+     std::vector<double> vals;       // parse target, copied into m on success
+
+     std::size_t fill(char* dst, std::size_t want);
+     bool        token(const char*& b, const char*& e);
+ };
+
+ } // namespace mat
+
+ #endif // SQUARE_MAT_STREAM_H
@@ -0,0 +1,66 @@
+/*  Author: <Thelet.Shevach@gmail.com
+ *  SquareMat_sym.h – symmetric matrix with packed upper-triangle storage.
+ */
+ #ifndef SQUARE_MAT_SYM_H
+ #define SQUARE_MAT_SYM_H
+
+ #include "SquareMat.h"
+ #include <cstddef>
+ #include <iostream>
+
+ namespace mat {
+
+ class SymmetricMat {
+     std::size_t n;    // dimension (n×n)
+     double*    buf;   // packed upper triangle, row by row: n(n+1)/2 values
+
+     // packed offset of (i,j), i <= j
+     std::size_t idx(std::size_t i, std::size_t j) const { return i*n - i*(i-1)/2 + (j - i); }
+
+ public:
+     //─── Rule of Three ───────────────────────────────────────
+     explicit SymmetricMat(std::size_t dim, double val = 0.0);
+     /// from a SquareMat; invalid_argument if |a(i,j)-a(j,i)| > tol anywhere
+     explicit SymmetricMat(const SquareMat& m, double tol = 1e-9);
+     SymmetricMat(const SymmetricMat&);
+     SymmetricMat& operator=(const SymmetricMat&);
+     ~SymmetricMat();
+
+     /// A * ~A computed directly into packed storage (SYRK, ~half the flops)
+     static SymmetricMat syrk(const SquareMat& A);
+     static bool is_symmetric(const SquareMat& m, double tol = 1e-9);
+
+     //─── Element access (either triangle maps to the same cell) ─
+     double& operator()(std::size_t r, std::size_t c) {
+         if (r >= n || c >= n) throw std::invalid_argument("index out of range");
+         return r <= c ? buf[idx(r, c)] : buf[idx(c, r)];
+     }
+     double  operator()(std::size_t r, std::size_t c) const {
+         if (r >= n || c >= n) throw std::invalid_argument("index out of range");
+         return r <= c ? buf[idx(r, c)] : buf[idx(c, r)];
+     }
+     std::size_t   size()   const { return n; }
+     std::size_t   packed() const { return n*(n+1)/2; }  // stored values
+     const double* data()   const { return buf; }
+
+     SquareMat to_square() const;
+
+     //─── Arithmetic ─────────────────────────────────────────
+     SymmetricMat operator+(const SymmetricMat&) const;
+     SymmetricMat operator-(const SymmetricMat&) const;
+     SymmetricMat operator*(double)              const;
+     SquareMat    operator*(const SquareMat&)    const; // SYMM: S×B
+     SquareMat    operator*(const SymmetricMat&) const; // S×T (not symmetric in general)
+
+     /** Determinant: packed Cholesky (n³/6 flops) when positive definite,
+      *  pivoted Gaussian elimination on the full matrix otherwise. */
+     double operator!() const;
+
+     friend std::ostream& operator<<(std::ostream& out, const SymmetricMat& s) {
+         return out << s.to_square();
+     }
+ };
+
+ } // namespace mat
+
+ #endif // SQUARE_MAT_SYM_H
@@ -0,0 +1,33 @@
+/*  Author: <Thelet.Shevach@gmail.com
+ *  SquareMat_trace.h – timeline spans exported as Chrome / Perfetto JSON.
+ */
+ #ifndef SQUARE_MAT_TRACE_H
+ #define SQUARE_MAT_TRACE_H
+
+ #include <iosfwd>
+ #include <string>
+
+ namespace mat {
+ namespace trace {
+
+ /** Spans exist only when the library is built with -DSQUAREMAT_TRACE
+  *  (`make TRACE=1`); otherwise every call here is a no-op and the export
+  *  is an empty trace. Each thread records into its own fixed-size ring
+  *  without locking, so the newest events per thread are kept. */
+ bool compiled();
+
+ /// Start/stop recording. Also switched on by SQUAREMAT_TRACE=<file> at
+ /// load time, which writes the trace to <file> at exit.
+ void enable(bool on = true);
+ bool enabled();
+ /// drop every recorded event
+ void clear();
+
+ /// {"traceEvents": [...]} with one "X" event per span, timestamps in µs
+ void write_json(std::ostream& out);
+ bool write_json(const std::string& path);
+
+ } // namespace trace
+ } // namespace mat
+
+ #endif // SQUARE_MAT_TRACE_H
@@ -0,0 +1,85 @@
+/*  Author: <Thelet.Shevach@gmail.com
+ *  SquareMat_vec.h – dense vector type and matrix–vector products (GEMV).
+ */
+ #ifndef SQUARE_MAT_VEC_H
+ #define SQUARE_MAT_VEC_H
+
+ #include "SquareMat.h"
+ #include <cstddef>
+ #include <iostream>
+ #include <string>
+ #include <vector>
+
+ namespace mat {
+
+ class Vec {
+     std::size_t n;    // length
+     double*    buf;   // heap array of length n
+ public:
+     //─── Rule of Three ───────────────────────────────────────
+     explicit Vec(std::size_t len, double val = 0.0);
+     Vec(std::size_t len, const double* raw);
+     Vec(const Vec&);
+     Vec& operator=(const Vec&);
+     ~Vec();
+
+     /** Parse "a b c" (spaces and/or commas). */
+     static Vec from_string(const std::string& spec);
+
+     double& operator[](std::size_t i) {
+         SQUAREMAT_BOUNDS(i < n, "index out of range");
+         return buf[i];
+     }
+     const double& operator[](std::size_t i) const {
+         SQUAREMAT_BOUNDS(i < n, "index out of range");
+         return buf[i];
+     }
+     std::size_t   size()  const { return n; }
+     double*       data()        { return buf; }
+     const double* data()  const { return buf; }
+     double*       begin()       { return buf; }
+     double*       end()         { return buf + n; }
+     const double* begin() const { return buf; }
+     const double* end()   const { return buf + n; }
+
+     Vec  operator+(const Vec&) const;
+     Vec  operator-(const Vec&) const;
+     Vec  operator*(double)     const;
+     friend Vec operator*(double s, const Vec& v) { return v*s; }
+     double dot(const Vec&)     const;
+     double norm()              const;   // Euclidean
+
+     friend std::ostream& operator<<(std::ostream&, const Vec&);
+ };
+
+ //─── GEMV ───────────────────────────────────────────────────
+ /** y = alpha·op(A)·x + beta·y in y's storage; op(A) is A or Aᵀ.
+  *  Rows (or, for Aᵀ, column ranges) are split across the ThreadPool. */
+ void gemv(double alpha, const SquareMat& A, const Vec& x, double beta, Vec& y,
+           Trans t = Trans::No);
+
+ Vec operator*(const SquareMat& A, const Vec& x);   // A·x
+ Vec operator*(const Vec& x, const SquareMat& A);   // xᵀ·A  (= Aᵀ·x)
+
+ /// Aᵀ without materializing it: trans(A) * x
+ struct TransposedRef { const SquareMat& m; };
+ inline TransposedRef trans(const SquareMat& A) { return {A}; }
+ Vec operator*(TransposedRef At, const Vec& x);
+
+ /// A·x for every x in xs; each row of A is streamed once per group of four vectors
+ std::vector<Vec> multiply(const SquareMat& A, const std::vector<Vec>& xs);
+
+ //─── Power iteration ────────────────────────────────────────
+ struct EigenPair {
+     double      value;       // Rayleigh quotient of the final iterate
+     Vec         vector;      // unit length
+     std::size_t iterations;
+     bool        converged;
+ };
+ /** Dominant eigenpair of A; stops when successive unit iterates differ
+  *  by less than tol (up to sign) or after max_iter steps. */
+ EigenPair power_iteration(const SquareMat& A, std::size_t max_iter = 1000, double tol = 1e-10);
+
+ } // namespace mat
+
+ #endif // SQUARE_MAT_VEC_H
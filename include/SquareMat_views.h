@@ -0,0 +1,148 @@
+/*  Author: <Thelet.Shevach@gmail.com
+ *  SquareMat_views.h – non-owning views: strided (columns, diagonal), rows, blocks.
+ */
+ #ifndef SQUARE_MAT_VIEWS_H
+ #define SQUARE_MAT_VIEWS_H
+
+ #include <cstddef>
+ #include <iterator>
+ #include <span>
+ #include <stdexcept>
+ #include <type_traits>
+
+ namespace mat {
+
+ /// Random-access iterator stepping `stride` elements at a time.
+ template <class T>
+ class StridedIter {
+     T*             p      = nullptr;
+     std::ptrdiff_t stride = 1;
+ public:
+     using iterator_category = std::random_access_iterator_tag;
+     using iterator_concept  = std::random_access_iterator_tag;
+     using value_type        = std::remove_cv_t<T>;
+     using difference_type   = std::ptrdiff_t;
+     using pointer           = T*;
+     using reference         = T&;
+
+     StridedIter() = default;
+     StridedIter(T* ptr, std::ptrdiff_t s) : p(ptr), stride(s) {}
+
+     reference operator*()  const { return *p; }
+     pointer   operator->() const { return p; }
+     reference operator[](difference_type k) const { return p[k*stride]; }
+
+     StridedIter& operator++()    { p += stride; return *this; }
+     StridedIter  operator++(int) { StridedIter t = *this; p += stride; return t; }
+     StridedIter& operator--()    { p -= stride; return *this; }
+     StridedIter  operator--(int) { StridedIter t = *this; p -= stride; return t; }
+     StridedIter& operator+=(difference_type k) { p += k*stride; return *this; }
+     StridedIter& operator-=(difference_type k) { p -= k*stride; return *this; }
+     friend StridedIter operator+(StridedIter it, difference_type k) { return it += k; }
+     friend StridedIter operator+(difference_type k, StridedIter it) { return it += k; }
+     friend StridedIter operator-(StridedIter it, difference_type k) { return it -= k; }
+     friend difference_type operator-(const StridedIter& a, const StridedIter& b) {
+         return (a.p - b.p) / a.stride;
+     }
+
+     friend bool operator==(const StridedIter& a, const StridedIter& b) { return a.p == b.p; }
+     friend auto operator<=>(const StridedIter& a, const StridedIter& b) {
+         return a.stride > 0 ? a.p <=> b.p : b.p <=> a.p;
+     }
+ };
+
+ /// `count` elements starting at `first`, `stride` apart (column, diagonal, ...).
+ template <class T>
+ class StridedView {
+     T*             first;
+     std::size_t    count;
+     std::ptrdiff_t stride;
+ public:
+     using iterator = StridedIter<T>;
+
+     StridedView(T* p, std::size_t len, std::ptrdiff_t s) : first(p), count(len), stride(s) {}
+
+     iterator    begin() const { return iterator(first, stride); }
+     iterator    end()   const { return iterator(first + static_cast<std::ptrdiff_t>(count)*stride, stride); }
+     std::size_t size()  const { return count; }
+     T&          operator[](std::size_t i) const { return first[static_cast<std::ptrdiff_t>(i)*stride]; }
+ };
+
+ /// Range over the rows of a row-major n×n buffer, yielding std::span rows.
+ template <class T>
+ class RowRange {
+     T*          base;
+     std::size_t n;
+ public:
+     class iterator {
+         T*          p = nullptr;
+         std::size_t n = 0;
+     public:
+         using iterator_category = std::random_access_iterator_tag;
+         using value_type        = std::span<T>;
+         using difference_type   = std::ptrdiff_t;
+         using pointer           = void;
+         using reference         = std::span<T>;
+
+         iterator() = default;
+         iterator(T* ptr, std::size_t len) : p(ptr), n(len) {}
+         reference operator*() const { return {p, n}; }
+         reference operator[](difference_type k) const { return {p + k*static_cast<difference_type>(n), n}; }
+         iterator& operator++()    { p += n; return *this; }
+         iterator  operator++(int) { iterator t = *this; p += n; return t; }
+         iterator& operator--()    { p -= n; return *this; }
+         iterator  operator--(int) { iterator t = *this; p -= n; return t; }
+         iterator& operator+=(difference_type k) { p += k*static_cast<difference_type>(n); return *this; }
+         iterator& operator-=(difference_type k) { p -= k*static_cast<difference_type>(n); return *this; }
+         friend iterator operator+(iterator it, difference_type k) { return it += k; }
+         friend iterator operator+(difference_type k, iterator it) { return it += k; }
+         friend iterator operator-(iterator it, difference_type k) { return it -= k; }
+         friend difference_type operator-(const iterator& a, const iterator& b) {
+             return (a.p - b.p) / static_cast<difference_type>(a.n);
+         }
+         friend bool operator==(const iterator& a, const iterator& b) { return a.p == b.p; }
+         friend auto operator<=>(const iterator& a, const iterator& b) { return a.p <=> b.p; }
+     };
+
+     RowRange(T* p, std::size_t dim) : base(p), n(dim) {}
+     iterator    begin() const { return iterator(base, n); }
+     iterator    end()   const { return iterator(base + n*n, n); }
+     std::size_t size()  const { return n; }
+     std::span<T> operator[](std::size_t r) const { return {base + r*n, n}; }
+ };
+
+
+ /** Square size×size block inside a row-major buffer whose rows are `ld`
+  *  elements apart (top-left at `p`). Non-owning: the parent must outlive it. */
+ template <class T>
+ class BasicBlockView {
+     T*          p;
+     std::size_t n;
+     std::size_t stride;
+ public:
+     BasicBlockView(T* ptr, std::size_t size, std::size_t ld) : p(ptr), n(size), stride(ld) {}
+     template <class U, class = std::enable_if_t<std::is_convertible_v<U*, T*>>>
+     BasicBlockView(const BasicBlockView<U>& o) : p(o.data()), n(o.size()), stride(o.ld()) {}
+
+     T*          data() const { return p; }
+     std::size_t size() const { return n; }
+     std::size_t ld()   const { return stride; }
+
+     T& operator()(std::size_t r, std::size_t c) const { return p[r*stride + c]; }
+     T* row_ptr(std::size_t r) const { return p + r*stride; }
+     std::span<T> row(std::size_t r) const { return {p + r*stride, n}; }
+
+     /// nested block, relative to this one
+     BasicBlockView block(std::size_t r0, std::size_t c0, std::size_t size) const {
+         if (size == 0 || r0 + size > n || c0 + size > n)
+             throw std::invalid_argument("block out of range");
+         return BasicBlockView(p + r0*stride + c0, size, stride);
+     }
+ };
+
+ using BlockView      = BasicBlockView<double>;
+ using ConstBlockView = BasicBlockView<const double>;
+
+ } // namespace mat
+
+ #endif // SQUARE_MAT_VIEWS_H
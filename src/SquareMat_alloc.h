@@ -0,0 +1,34 @@
+/*  Author: <Thelet.Shevach@gmail.com
+ *  SquareMat_alloc.h : internal buffer allocation shared by all dense types.
+ *  Every buffer carries a small header so telemetry can be switched on and
+ *  off while buffers are alive; when it is off, alloc/free add one relaxed
+ *  atomic load to new[]/delete[].
+ */
+#ifndef SQUARE_MAT_ALLOC_H
+#define SQUARE_MAT_ALLOC_H
+
+#include <cstddef>
+
+namespace mat {
+namespace mem {
+
+/// uninitialised buffer of `count` doubles, attributed to `site`
+double* alloc(std::size_t count, const char* site);
+/// release a buffer from alloc (nullptr is ignored)
+void    free(double* p) noexcept;
+
+/// alloc'd scratch released at scope exit (count 0 holds nothing)
+class Scratch {
+    double* p;
+public:
+    Scratch(std::size_t count, const char* site) : p(count ? alloc(count, site) : nullptr) {}
+    ~Scratch() { free(p); }
+    Scratch(const Scratch&)            = delete;
+    Scratch& operator=(const Scratch&) = delete;
+    double* get() const { return p; }
+};
+
+} // namespace mem
+} // namespace mat
+
+#endif // SQUARE_MAT_ALLOC_H
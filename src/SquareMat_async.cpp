@@ -0,0 +1,125 @@
+/*  Author: <Thelet.Shevach@gmail.com
+ *  SquareMat_async.cpp : future-returning, cancellable operators.
+ */
+
+#include "SquareMat_async.h"
+#include "SquareMat_alloc.h"
+#include "SquareMat_chol.h"
+#include "SquareMat_instr.h"
+#include "SquareMat_kernels.h"
+#include "SquareMat_pool.h"
+#include <algorithm>
+#include <utility>
+
+using std::size_t;
+using std::invalid_argument;
+
+namespace mat {
+
+namespace {
+
+constexpr size_t kRowBlock = 32;
+
+void check(const std::atomic<bool>& stop) {
+    if (stop.load(std::memory_order_relaxed)) throw Cancelled();
+}
+
+/// operator* with a cancellation check per block of rows
+SquareMat multiply(const SquareMat& A, const SquareMat& B, const std::atomic<bool>& stop) {
+    const size_t n = A.size();
+    if (B.size() != n) throw invalid_argument("size mismatch");
+    SQUAREMAT_SCOPE("async_mul", n);
+    SquareMat C(n, 0.0);
+    const auto sa = A.structure(), sb = B.structure();
+    const double* a = A.data();
+    const double* b = B.data();
+    double*       c = C.data();
+    parallel_for(0, n, kRowBlock, [&](size_t lo, size_t hi) {
+        if (stop.load(std::memory_order_relaxed)) return;
+        for (size_t i = lo; i < hi; ++i)
+            kern::gemm_row(n, i, a + i*n, 1, sa.lower, sa.upper, b, n, false, sb.lower, sb.upper, c + i*n);
+    });
+    check(stop);
+    return C;
+}
+
+double determinant(const SquareMat& A, const std::atomic<bool>& stop) {
+    const size_t n = A.size();
+    // only the O(n²) diagonal product skips the checks; A may share its
+    // buffer with the caller (copy-on-write), so factorizations run on copies
+    const auto kind = A.structure().kind;
+    if (kind == Structure::Diagonal || kind == Structure::Upper || kind == Structure::Lower) return !A;
+    SQUAREMAT_SCOPE("async_det", n);
+    const double* src = A.data();
+    if (n > 1 && Cholesky::maybe_spd(A)) {
+        mem::Scratch chol(n*n, "chol_scratch");
+        double* L = chol.get();
+        std::copy(src, src + n*n, L);
+        const bool spd = kern::cholesky(n, L, n);
+        check(stop);
+        if (spd) {
+            double d = 1.0;
+            for (size_t i = 0; i < n; ++i) d *= L[i*n + i];
+            return d * d;
+        }
+    }
+    mem::Scratch scratch(n*n, "lu_scratch");
+    double* tmp = scratch.get();
+    std::copy(src, src + n*n, tmp);
+    const double d = kern::lu_det(n, tmp, n, &stop);
+    check(stop);
+    return d;
+}
+
+SquareMat power(const SquareMat& A, unsigned int p, const std::atomic<bool>& stop) {
+    if (p == 0 || A.structure().kind == Structure::Diagonal) return A ^ p;
+    SquareMat base(A), res(A);
+    for (--p; p; p >>= 1) {
+        if (p & 1) res = multiply(res, base, stop);
+        if (p > 1) base = multiply(base, base, stop);
+    }
+    return res;
+}
+
+template <class T, class Work>
+std::future<T> launch(Work work, const CancelToken& tok, Completion<T> done) {
+    auto promise = std::make_shared<std::promise<T>>();
+    std::future<T> fut = promise->get_future();
+    ThreadPool::instance().submit([promise, work = std::move(work), tok, done = std::move(done)] {
+        std::exception_ptr err;
+        try {
+            check(tok.state());
+            T r = work(tok.state());
+            if (done) try { done(&r, nullptr); } catch (...) {}
+            promise->set_value(std::move(r));
+            return;
+        } catch (...) {
+            err = std::current_exception();
+        }
+        if (done) try { done(nullptr, err); } catch (...) {}
+        promise->set_exception(err);
+    });
+    return fut;
+}
+
+} // namespace
+
+std::future<SquareMat> async_multiply(SquareMat A, SquareMat B, CancelToken tok, Completion<SquareMat> done) {
+    return launch<SquareMat>([A = std::move(A), B = std::move(B)](const std::atomic<bool>& stop) {
+        return multiply(A, B, stop);
+    }, tok, std::move(done));
+}
+
+std::future<double> async_det(SquareMat A, CancelToken tok, Completion<double> done) {
+    return launch<double>([A = std::move(A)](const std::atomic<bool>& stop) {
+        return determinant(A, stop);
+    }, tok, std::move(done));
+}
+
+std::future<SquareMat> async_pow(SquareMat A, unsigned int p, CancelToken tok, Completion<SquareMat> done) {
+    return launch<SquareMat>([A = std::move(A), p](const std::atomic<bool>& stop) {
+        return power(A, p, stop);
+    }, tok, std::move(done));
+}
+
+} // namespace mat
@@ -0,0 +1,153 @@
+/*  Author: <Thelet.Shevach@gmail.com
+ *  SquareMat_block.cpp : arithmetic on non-owning block views.
+ */
+
+#include "SquareMat.h"
+#include "SquareMat_kernels.h"
+#include "SquareMat_alloc.h"
+#include <stdexcept>
+
+using std::size_t;
+using std::invalid_argument;
+
+namespace mat {
+
+namespace {
+
+void match(ConstBlockView a, ConstBlockView b) {
+    if (a.size() != b.size()) throw invalid_argument("size mismatch");
+}
+
+void no_alias(ConstBlockView in, ConstBlockView out) {
+    if (kern::overlap(in.size(), in.data(), in.ld(), out.data(), out.ld()))
+        throw invalid_argument("output block aliases an input");
+}
+
+// element-wise kernels tolerate exact in-place use, not a shifted overlap
+void elementwise_ok(ConstBlockView in, ConstBlockView out) {
+    if (in.data() == out.data() && in.ld() == out.ld()) return;
+    no_alias(in, out);
+}
+
+} // namespace
+
+SquareMat::SquareMat(ConstBlockView v)
+ : n(v.size()), buf(nullptr)
+{
+    if (n == 0) throw invalid_argument("size must be >0");
+    buf = mem::alloc(n*n, "ctor");
+    kern::copy(n, v.data(), v.ld(), buf, n);
+}
+
+BlockView SquareMat::block(size_t r0, size_t c0, size_t size) {
+    return view().block(r0, c0, size);
+}
+
+ConstBlockView SquareMat::block(size_t r0, size_t c0, size_t size) const {
+    return view().block(r0, c0, size);
+}
+
+//─── Results into a fresh SquareMat ─────────────────────────
+
+SquareMat operator+(ConstBlockView a, ConstBlockView b) {
+    match(a, b);
+    SquareMat r(a.size());
+    kern::add(a.size(), a.data(), a.ld(), b.data(), b.ld(), r.data(), r.size());
+    return r;
+}
+
+SquareMat operator-(ConstBlockView a, ConstBlockView b) {
+    match(a, b);
+    SquareMat r(a.size());
+    kern::sub(a.size(), a.data(), a.ld(), b.data(), b.ld(), r.data(), r.size());
+    return r;
+}
+
+SquareMat operator%(ConstBlockView a, ConstBlockView b) {
+    match(a, b);
+    SquareMat r(a.size());
+    kern::hadamard(a.size(), a.data(), a.ld(), b.data(), b.ld(), r.data(), r.size());
+    return r;
+}
+
+SquareMat operator*(ConstBlockView a, ConstBlockView b) {
+    match(a, b);
+    SquareMat r(a.size(), 0.0);
+    kern::gemm_acc(a.size(), a.data(), a.ld(), b.data(), b.ld(), r.data(), r.size());
+    return r;
+}
+
+SquareMat operator*(ConstBlockView a, double s) {
+    SquareMat r(a.size());
+    kern::scale(a.size(), a.data(), a.ld(), s, r.data(), r.size());
+    return r;
+}
+
+SquareMat operator~(ConstBlockView a) {
+    SquareMat r(a.size());
+    kern::transpose(a.size(), a.data(), a.ld(), r.data(), r.size());
+    return r;
+}
+
+//─── In place on the parent buffer ──────────────────────────
+
+void assign(BlockView out, ConstBlockView a) {
+    match(a, out);
+    elementwise_ok(a, out);
+    kern::copy(a.size(), a.data(), a.ld(), out.data(), out.ld());
+}
+
+void add(ConstBlockView a, ConstBlockView b, BlockView out) {
+    match(a, b); match(a, out);
+    elementwise_ok(a, out); elementwise_ok(b, out);
+    kern::add(a.size(), a.data(), a.ld(), b.data(), b.ld(), out.data(), out.ld());
+}
+
+void sub(ConstBlockView a, ConstBlockView b, BlockView out) {
+    match(a, b); match(a, out);
+    elementwise_ok(a, out); elementwise_ok(b, out);
+    kern::sub(a.size(), a.data(), a.ld(), b.data(), b.ld(), out.data(), out.ld());
+}
+
+void multiply(ConstBlockView a, ConstBlockView b, BlockView out) {
+    match(a, b); match(a, out);
+    no_alias(a, out); no_alias(b, out);
+    const size_t n = out.size();
+    for (size_t i = 0; i < n; ++i)
+        for (size_t j = 0; j < n; ++j) out(i, j) = 0.0;
+    kern::gemm_acc(n, a.data(), a.ld(), b.data(), b.ld(), out.data(), out.ld());
+}
+
+void transpose(ConstBlockView a, BlockView out) {
+    match(a, out);
+    if (!(a.data() == out.data() && a.ld() == out.ld())) no_alias(a, out);
+    kern::transpose(a.size(), a.data(), a.ld(), out.data(), out.ld());
+}
+
+BlockView operator+=(BlockView dst, ConstBlockView a) {
+    match(a, dst);
+    elementwise_ok(a, dst);
+    kern::add(a.size(), dst.data(), dst.ld(), a.data(), a.ld(), dst.data(), dst.ld());
+    return dst;
+}
+
+BlockView operator-=(BlockView dst, ConstBlockView a) {
+    match(a, dst);
+    elementwise_ok(a, dst);
+    kern::sub(a.size(), dst.data(), dst.ld(), a.data(), a.ld(), dst.data(), dst.ld());
+    return dst;
+}
+
+BlockView operator%=(BlockView dst, ConstBlockView a) {
+    match(a, dst);
+    elementwise_ok(a, dst);
+    kern::hadamard(a.size(), dst.data(), dst.ld(), a.data(), a.ld(), dst.data(), dst.ld());
+    return dst;
+}
+
+BlockView operator*=(BlockView dst, double s) {
+    kern::scale(dst.size(), dst.data(), dst.ld(), s, dst.data(), dst.ld());
+    return dst;
+}
+
+} // namespace mat
@@ -0,0 +1,153 @@
+/*  Author: <Thelet.Shevach@gmail.com
+ *  SquareMat_chol.cpp : blocked parallel Cholesky, det/log_det/solve.
+ */
+
+#include "SquareMat_chol.h"
+#include "SquareMat_kernels.h"
+#include "SquareMat_pool.h"
+#include "SquareMat_instr.h"
+#include <cmath>
+#include <stdexcept>
+
+using std::size_t;
+using std::invalid_argument;
+
+namespace mat {
+
+namespace kern {
+
+namespace {
+
+constexpr size_t kBlock = 64;   // panel width
+constexpr size_t kGrain = 16;   // rows per parallel chunk
+
+// unblocked lower Cholesky of the kb×kb diagonal block at a
+bool potf2(size_t kb, double* a, size_t lda) {
+    for (size_t j = 0; j < kb; ++j) {
+        double* rj = a + j*lda;
+        double d = rj[j];
+        for (size_t t = 0; t < j; ++t) d -= rj[t] * rj[t];
+        if (!(d > 0.0)) return false;
+        d = std::sqrt(d);
+        rj[j] = d;
+        for (size_t i = j+1; i < kb; ++i) {
+            double* ri = a + i*lda;
+            double s = ri[j];
+            for (size_t t = 0; t < j; ++t) s -= ri[t] * rj[t];
+            ri[j] = s / d;
+        }
+    }
+    return true;
+}
+
+} // namespace
+
+bool cholesky(size_t n, double* a, size_t lda) {
+    SQUAREMAT_SCOPE("cholesky", n);
+    for (size_t k0 = 0; k0 < n; k0 += kBlock) {
+        const size_t kb = k0 + kBlock < n ? kBlock : n - k0;
+        double* akk = a + k0*lda + k0;
+        if (!potf2(kb, akk, lda)) return false;
+        const size_t rest = k0 + kb;
+        if (rest == n) break;
+
+        // panel: L(i,k0:rest) = A(i,k0:rest) · L_kk⁻ᵀ, row by row
+        parallel_for(rest, n, kGrain, [=](size_t lo, size_t hi) {
+            for (size_t i = lo; i < hi; ++i) {
+                double* x = a + i*lda + k0;
+                for (size_t j = 0; j < kb; ++j) {
+                    const double* lj = akk + j*lda;
+                    double s = x[j];
+                    for (size_t t = 0; t < j; ++t) s -= x[t] * lj[t];
+                    x[j] = s / lj[j];
+                }
+            }
+        });
+
+        // trailing update of the lower triangle: A(i,j) -= <L(i,panel), L(j,panel)>
+        parallel_for(rest, n, kGrain, [=](size_t lo, size_t hi) {
+            for (size_t i = lo; i < hi; ++i) {
+                const double* li = a + i*lda + k0;
+                double*       ri = a + i*lda;
+                for (size_t j = rest; j <= i; ++j) {
+                    const double* lj = a + j*lda + k0;
+                    double s = 0.0;
+                    for (size_t t = 0; t < kb; ++t) s += li[t] * lj[t];
+                    ri[j] -= s;
+                }
+            }
+        });
+    }
+    for (size_t i = 0; i < n; ++i)
+        for (size_t j = i+1; j < n; ++j) a[i*lda + j] = 0.0;
+    return true;
+}
+
+} // namespace kern
+
+Cholesky::Cholesky(const SquareMat& A) : L(A) {
+    if (!maybe_spd(A) || !kern::cholesky(L.size(), L.data(), L.size()))
+        throw invalid_argument("matrix is not positive definite");
+}
+
+bool Cholesky::maybe_spd(const SquareMat& A) {
+    const size_t n = A.size();
+    const double* a = A.data();
+    for (size_t i = 0; i < n; ++i) {
+        if (!(a[i*n + i] > 0.0)) return false;
+        for (size_t j = i+1; j < n; ++j)
+            if (a[i*n + j] != a[j*n + i]) return false;
+    }
+    return true;
+}
+
+bool Cholesky::is_spd(const SquareMat& A) {
+    if (!maybe_spd(A)) return false;
+    SquareMat tmp(A);
+    return kern::cholesky(tmp.size(), tmp.data(), tmp.size());
+}
+
+double Cholesky::det() const {
+    double d = 1.0;
+    for (size_t i = 0; i < L.size(); ++i) d *= L.at_unchecked(i, i);
+    return d * d;
+}
+
+double Cholesky::log_det() const {
+    double s = 0.0;
+    for (size_t i = 0; i < L.size(); ++i) s += std::log(L.at_unchecked(i, i));
+    return 2.0 * s;
+}
+
+SquareMat Cholesky::solve(const SquareMat& B) const {
+    const size_t n = L.size();
+    if (B.size() != n) throw invalid_argument("size mismatch");
+    SquareMat X(B);
+    double*       x = X.data();
+    const double* l = L.data();
+    // forward: L·Y = B, whole rows at a time
+    for (size_t i = 0; i < n; ++i) {
+        double* xi = x + i*n;
+        for (size_t k = 0; k < i; ++k) {
+            const double f = l[i*n + k];
+            const double* xk = x + k*n;
+            for (size_t j = 0; j < n; ++j) xi[j] -= f * xk[j];
+        }
+        const double inv = 1.0 / l[i*n + i];
+        for (size_t j = 0; j < n; ++j) xi[j] *= inv;
+    }
+    // backward: Lᵀ·X = Y
+    for (size_t i = n; i-- > 0;) {
+        double* xi = x + i*n;
+        for (size_t k = i+1; k < n; ++k) {
+            const double f = l[k*n + i];
+            const double* xk = x + k*n;
+            for (size_t j = 0; j < n; ++j) xi[j] -= f * xk[j];
+        }
+        const double inv = 1.0 / l[i*n + i];
+        for (size_t j = 0; j < n; ++j) xi[j] *= inv;
+    }
+    return X;
+}
+
+} // namespace mat
@@ -0,0 +1,310 @@
+/*  Author: <Thelet.Shevach@gmail.com
+ *  SquareMat_compress.cpp : LZ codec and the chunked .sqmz container.
+ */
+
+#include "SquareMat_compress.h"
+#include "SquareMat_pool.h"
+#include "SquareMat_instr.h"
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <stdexcept>
+#include <unistd.h>
+
+using std::size_t;
+using std::uint32_t;
+using std::uint64_t;
+using std::invalid_argument;
+using Bytes = std::vector<unsigned char>;
+
+namespace {
+
+//─── LZ codec ───────────────────────────────────────────────
+// Sequence = token (literal len:4 | match len-4:4), optional 255-run length
+// extensions, literals, 2-byte LE offset, match extension. The final
+// sequence carries literals only.
+
+constexpr size_t kMinMatch  = 4;
+constexpr size_t kTailBytes = 5;       // always emitted as literals
+constexpr size_t kMaxOffset = 65535;
+constexpr int    kHashBits  = 16;
+
+inline uint32_t load32(const unsigned char* p) { uint32_t v; std::memcpy(&v, p, 4); return v; }
+inline uint32_t hash32(uint32_t v) { return (v * 2654435761u) >> (32 - kHashBits); }
+
+void put_length(Bytes& out, size_t len) {
+    while (len >= 255) { out.push_back(255); len -= 255; }
+    out.push_back(static_cast<unsigned char>(len));
+}
+
+void emit(Bytes& out, const unsigned char* lit, size_t lit_len, size_t offset, size_t match_len) {
+    const size_t ml = match_len ? match_len - kMinMatch : 0;
+    out.push_back(static_cast<unsigned char>(((lit_len < 15 ? lit_len : 15) << 4) |
+                                             (ml < 15 ? ml : 15)));
+    if (lit_len >= 15) put_length(out, lit_len - 15);
+    out.insert(out.end(), lit, lit + lit_len);
+    if (!match_len) return;
+    out.push_back(static_cast<unsigned char>(offset & 0xff));
+    out.push_back(static_cast<unsigned char>(offset >> 8));
+    if (ml >= 15) put_length(out, ml - 15);
+}
+
+//─── Byte shuffle ───────────────────────────────────────────
+
+void shuffle(const double* src, size_t count, unsigned char* dst) {
+    const unsigned char* s = reinterpret_cast<const unsigned char*>(src);
+    for (size_t i = 0; i < count; ++i)
+        for (size_t b = 0; b < sizeof(double); ++b)
+            dst[b*count + i] = s[i*sizeof(double) + b];
+}
+
+void unshuffle(const unsigned char* src, size_t count, double* dst) {
+    unsigned char* d = reinterpret_cast<unsigned char*>(dst);
+    for (size_t b = 0; b < sizeof(double); ++b)
+        for (size_t i = 0; i < count; ++i)
+            d[i*sizeof(double) + b] = src[b*count + i];
+}
+
+//─── File helpers ───────────────────────────────────────────
+
+constexpr char     kMagic[4] = {'S', 'Q', 'M', 'Z'};
+constexpr uint32_t kVersion  = 1;
+constexpr uint32_t kRaw = 0, kLZ = 1;
+constexpr size_t   kHeaderBytes = 4 + 4 + 8 + 8 + 8;    // magic, version, n, rows/block, blocks
+constexpr size_t   kEntryBytes  = 8 + 8 + 4 + 4;        // offset, bytes, method, reserved
+
+void put_u32(unsigned char* p, uint32_t v) { for (int i = 0; i < 4; ++i) p[i] = static_cast<unsigned char>(v >> (8*i)); }
+void put_u64(unsigned char* p, uint64_t v) { for (int i = 0; i < 8; ++i) p[i] = static_cast<unsigned char>(v >> (8*i)); }
+uint32_t get_u32(const unsigned char* p) { uint32_t v = 0; for (int i = 3; i >= 0; --i) v = (v << 8) | p[i]; return v; }
+uint64_t get_u64(const unsigned char* p) { uint64_t v = 0; for (int i = 7; i >= 0; --i) v = (v << 8) | p[i]; return v; }
+
+void write_all(int fd, const unsigned char* p, size_t len) {
+    while (len) {
+        ssize_t w = ::write(fd, p, len);
+        if (w < 0) {
+            if (errno == EINTR) continue;
+            throw std::runtime_error("write failed");
+        }
+        p += w; len -= static_cast<size_t>(w);
+    }
+}
+
+void pread_all(int fd, unsigned char* p, size_t len, uint64_t off) {
+    while (len) {
+        ssize_t r = ::pread(fd, p, len, static_cast<off_t>(off));
+        if (r < 0 && errno == EINTR) continue;
+        if (r <= 0) throw invalid_argument("sqmz: truncated file");
+        p += r; len -= static_cast<size_t>(r); off += static_cast<uint64_t>(r);
+    }
+}
+
+size_t default_block_rows(size_t n) {
+    size_t rows = (256u << 10) / (n * sizeof(double));
+    return rows ? rows : 1;
+}
+
+} // namespace
+
+namespace mat {
+
+Bytes lz_compress(const unsigned char* src, size_t len) {
+    Bytes out;
+    out.reserve(len / 2 + 16);
+    size_t anchor = 0;
+    if (len > kMinMatch + kTailBytes) {
+        std::vector<uint32_t> table(size_t(1) << kHashBits, 0);   // position+1, 0 = empty
+        const size_t limit = len - kTailBytes;
+        size_t ip = 0;
+        while (ip + kMinMatch <= limit) {
+            const uint32_t seq = load32(src + ip);
+            const uint32_t h   = hash32(seq);
+            const size_t cand  = table[h];
+            table[h] = static_cast<uint32_t>(ip + 1);
+            if (cand && ip - (cand - 1) <= kMaxOffset && load32(src + cand - 1) == seq) {
+                const size_t ref = cand - 1;
+                size_t m = kMinMatch;
+                while (ip + m < limit && src[ref + m] == src[ip + m]) ++m;
+                emit(out, src + anchor, ip - anchor, ip - ref, m);
+                ip += m;
+                anchor = ip;
+            } else {
+                ++ip;
+            }
+        }
+    }
+    emit(out, src + anchor, len - anchor, 0, 0);
+    return out;
+}
+
+void lz_decompress(const unsigned char* src, size_t len, unsigned char* out, size_t out_len) {
+    const unsigned char* ip  = src;
+    const unsigned char* end = src + len;
+    size_t op = 0;
+    auto read_length = [&](size_t base) {
+        size_t v = base;
+        if (base == 15) {
+            unsigned char b;
+            do {
+                if (ip == end) throw invalid_argument("lz: truncated length");
+                b = *ip++;
+                v += b;
+            } while (b == 255);
+        }
+        return v;
+    };
+    while (ip < end) {
+        const unsigned char token = *ip++;
+        size_t lit = read_length(token >> 4);
+        if (lit > size_t(end - ip) || lit > out_len - op) throw invalid_argument("lz: literal overrun");
+        std::memcpy(out + op, ip, lit);
+        ip += lit; op += lit;
+        if (ip == end) break;
+        if (end - ip < 2) throw invalid_argument("lz: truncated offset");
+        const size_t offset = ip[0] | (size_t(ip[1]) << 8);
+        ip += 2;
+        size_t m = read_length(token & 15) + kMinMatch;
+        if (offset == 0 || offset > op) throw invalid_argument("lz: bad offset");
+        if (m > out_len - op) throw invalid_argument("lz: match overrun");
+        for (size_t i = 0; i < m; ++i, ++op) out[op] = out[op - offset];  // may overlap
+    }
+    if (op != out_len) throw invalid_argument("lz: size mismatch");
+}
+
+//─── Writer ─────────────────────────────────────────────────
+
+void save_compressed(const SquareMat& m, const std::string& path, size_t rows_per_block) {
+    SQUAREMAT_TRACE_SPAN("save_compressed", m.size());
+    const size_t n = m.n;
+    const size_t rows = rows_per_block ? rows_per_block : default_block_rows(n);
+    const size_t nblocks = (n + rows - 1) / rows;
+
+    std::vector<Bytes>    payload(nblocks);
+    std::vector<uint32_t> method(nblocks);
+    parallel_for(0, nblocks, 1, [&](size_t lo, size_t hi) {
+        Bytes shuffled;
+        for (size_t b = lo; b < hi; ++b) {
+            const size_t r0 = b * rows, r1 = r0 + rows < n ? r0 + rows : n;
+            const size_t count = (r1 - r0) * n;
+            shuffled.resize(count * sizeof(double));
+            shuffle(m.buf + r0*n, count, shuffled.data());
+            payload[b] = lz_compress(shuffled.data(), shuffled.size());
+            method[b] = kLZ;
+            if (payload[b].size() >= shuffled.size()) {
+                payload[b].assign(reinterpret_cast<const unsigned char*>(m.buf + r0*n),
+                                  reinterpret_cast<const unsigned char*>(m.buf + r1*n));
+                method[b] = kRaw;
+            }
+        }
+    });
+
+    Bytes head(kHeaderBytes + nblocks * kEntryBytes);
+    std::memcpy(head.data(), kMagic, 4);
+    put_u32(&head[4], kVersion);
+    put_u64(&head[8], n);
+    put_u64(&head[16], rows);
+    put_u64(&head[24], nblocks);
+    uint64_t off = head.size();
+    for (size_t b = 0; b < nblocks; ++b) {
+        unsigned char* e = &head[kHeaderBytes + b*kEntryBytes];
+        put_u64(e, off);
+        put_u64(e + 8, payload[b].size());
+        put_u32(e + 16, method[b]);
+        put_u32(e + 20, 0);
+        off += payload[b].size();
+    }
+
+    int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) throw std::runtime_error("cannot open " + path);
+    try {
+        write_all(fd, head.data(), head.size());
+        for (const Bytes& p : payload) write_all(fd, p.data(), p.size());
+    } catch (...) { ::close(fd); throw; }
+    if (::close(fd) != 0) throw std::runtime_error("write failed");
+}
+
+SquareMat load_compressed(const std::string& path) {
+    SQUAREMAT_TRACE_SPAN("load_compressed", 0);
+    return CompressedMatFile(path).load();
+}
+
+//─── Random-access reader ───────────────────────────────────
+
+CompressedMatFile::CompressedMatFile(const std::string& path)
+ : fd(::open(path.c_str(), O_RDONLY)), n(0), block_rows(0)
+{
+    if (fd < 0) throw std::runtime_error("cannot open " + path);
+    try {
+        unsigned char head[kHeaderBytes];
+        pread_all(fd, head, sizeof head, 0);
+        if (std::memcmp(head, kMagic, 4) != 0) throw invalid_argument("sqmz: bad magic");
+        if (get_u32(head + 4) != kVersion)     throw invalid_argument("sqmz: unsupported version");
+        n          = get_u64(head + 8);
+        block_rows = get_u64(head + 16);
+        const uint64_t nblocks = get_u64(head + 24);
+        if (n == 0 || block_rows == 0 || nblocks != (n + block_rows - 1) / block_rows)
+            throw invalid_argument("sqmz: corrupt header");
+
+        Bytes index(nblocks * kEntryBytes);
+        pread_all(fd, index.data(), index.size(), kHeaderBytes);
+        blocks.resize(nblocks);
+        for (size_t b = 0; b < nblocks; ++b) {
+            const unsigned char* e = &index[b * kEntryBytes];
+            blocks[b] = {get_u64(e), get_u64(e + 8), get_u32(e + 16)};
+            if (blocks[b].method != kRaw && blocks[b].method != kLZ)
+                throw invalid_argument("sqmz: unknown block method");
+        }
+    } catch (...) { ::close(fd); throw; }
+}
+
+CompressedMatFile::~CompressedMatFile() { ::close(fd); }
+
+size_t CompressedMatFile::compressed_bytes() const {
+    size_t total = 0;
+    for (const Block& b : blocks) total += b.bytes;
+    return total;
+}
+
+void CompressedMatFile::read_rows(size_t first, size_t count, double* out) const {
+    if (first > n || count > n - first) throw invalid_argument("row range out of bounds");
+    if (count == 0) return;
+    const size_t b0 = first / block_rows, b1 = (first + count - 1) / block_rows + 1;
+
+    parallel_for(b0, b1, 1, [&](size_t lo, size_t hi) {
+        Bytes packed, plain;
+        std::vector<double> rows;
+        for (size_t b = lo; b < hi; ++b) {
+            const size_t r0 = b * block_rows, r1 = r0 + block_rows < n ? r0 + block_rows : n;
+            const size_t elems = (r1 - r0) * n;
+            packed.resize(blocks[b].bytes);
+            pread_all(fd, packed.data(), packed.size(), blocks[b].offset);
+
+            // decode straight into out when the block lies fully inside the request
+            const bool whole = r0 >= first && r1 <= first + count;
+            double* dst = out + (r0 > first ? r0 - first : 0) * n;
+            if (!whole) { rows.resize(elems); dst = rows.data(); }
+
+            if (blocks[b].method == kRaw) {
+                if (packed.size() != elems * sizeof(double)) throw invalid_argument("sqmz: bad raw block");
+                std::memcpy(dst, packed.data(), packed.size());
+            } else {
+                plain.resize(elems * sizeof(double));
+                lz_decompress(packed.data(), packed.size(), plain.data(), plain.size());
+                unshuffle(plain.data(), elems, dst);
+            }
+            if (!whole) {
+                const size_t s = r0 > first ? r0 : first;
+                const size_t e = r1 < first + count ? r1 : first + count;
+                std::memcpy(out + (s - first)*n, rows.data() + (s - r0)*n, (e - s)*n*sizeof(double));
+            }
+        }
+    });
+}
+
+SquareMat CompressedMatFile::load() const {
+    SquareMat M(1);
+    M.reshape(n);
+    read_rows(0, n, M.buf);
+    return M;
+}
+
+} // namespace mat
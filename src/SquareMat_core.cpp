@@ -3,119 +3,269 @@
  */
 
 #include "SquareMat.h"
-#include <sstream>
+#include "SquareMat_chol.h"
+#include "SquareMat_kernels.h"
+#include "SquareMat_instr.h"
+#include "SquareMat_alloc.h"
+#include "SquareMat_numa.h"
+#include "SquareMat_pool.h"
+#include <algorithm>
+#include <cctype>
+#include <charconv>
 #include <cmath>
 #include <stdexcept>
+#include <string>
 
 using std::size_t;
 using std::invalid_argument;
 
+namespace {
+
+constexpr size_t kTouchRows = 16;   // same row grain as operator*
+
+// Fill dst row by row via row(i, dst + i*n). Large buffers are filled on the
+// pool so each page is first touched (and placed) on a node whose workers
+// later take the same rows.
+template <class Row>
+void touch_rows(size_t n, double* dst, Row row) {
+    if (n*n*sizeof(double) < mat::numa::kMinBytes) {
+        for (size_t i = 0; i < n; ++i) row(i, dst + i*n);
+        return;
+    }
+    mat::parallel_for(0, n, kTouchRows, [&](size_t lo, size_t hi) {
+        for (size_t i = lo; i < hi; ++i) row(i, dst + i*n);
+    });
+}
+
+// Skip blanks; returns first non-space char (or end).
+const char* skip_ws(const char* p, const char* end) {
+    while (p != end && std::isspace(static_cast<unsigned char>(*p))) ++p;
+    return p;
+}
+
+// Count whitespace-separated tokens up to the first ',' (or end).
+size_t count_first_row(const char* p, const char* end, bool& has_comma) {
+    size_t count = 0;
+    has_comma = false;
+    while (p != end) {
+        p = skip_ws(p, end);
+        if (p == end) break;
+        if (*p == ',') { has_comma = true; break; }
+        ++count;
+        while (p != end && *p != ',' && !std::isspace(static_cast<unsigned char>(*p))) ++p;
+    }
+    return count;
+}
+
+[[noreturn]] void parse_error(const std::string& what, const char* pos, const char* begin) {
+    throw invalid_argument("from_string: " + what + " at position " +
+                           std::to_string(static_cast<size_t>(pos - begin)));
+}
+
+} // namespace
+
 namespace mat {
 
 void SquareMat::copy_from(const SquareMat& o) {
     n = o.n;
-    data = new double[n*n];
-    for (size_t i = 0; i < n*n; ++i) data[i] = o.data[i];
+    if (o.refs && !o.leaked) {          // COW: share, do not copy
+        buf  = o.buf;
+        refs = o.refs;
+        refs->fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    // a leaked COW buffer may still be written through o's pointers: copy
+    // it, but keep the copy in COW mode
+    buf  = mem::alloc(n*n, "copy");
+    refs = o.refs ? new std::atomic<size_t>(1) : nullptr;
+    const double* src = o.buf;
+    touch_rows(n, buf, [&](size_t i, double* r) { std::copy(src + i*n, src + (i+1)*n, r); });
+}
+
+void SquareMat::release() {
+    if (refs) {
+        if (refs->fetch_sub(1, std::memory_order_acq_rel) != 1) {
+            buf = nullptr; refs = nullptr; leaked = false;
+            return;
+        }
+        delete refs;
+        refs = nullptr;
+    }
+    mem::free(buf);
+    buf = nullptr;
+    leaked = false;
+}
+
+void SquareMat::unshare() {
+    double* fresh = mem::alloc(n*n, "unshare");
+    auto*   count = new std::atomic<size_t>(1);
+    touch_rows(n, fresh, [&](size_t i, double* r) { std::copy(buf + i*n, buf + (i+1)*n, r); });
+    release();
+    buf  = fresh;
+    refs = count;
+}
+
+SquareMat& SquareMat::enable_cow() {
+    if (!refs) refs = new std::atomic<size_t>(1);
+    return *this;
+}
+
+void SquareMat::reshape(size_t dim) {
+    if (dim == n && !is_shared()) return;
+    if (dim == 0) throw invalid_argument("size must be >0");
+    // contents are about to be overwritten: a shared buffer is dropped, not copied
+    double* fresh = mem::alloc(dim*dim, "reshape");
+    const bool was_cow = cow();
+    release();
+    buf = fresh;
+    n = dim;
+    if (was_cow) refs = new std::atomic<size_t>(1);
 }
 
 double SquareMat::sum() const {
     double s = 0.0;
-    for (size_t i = 0; i < n*n; ++i) s += data[i];
+    for (size_t i = 0; i < n*n; ++i) s += buf[i];
     return s;
 }
 
 SquareMat::SquareMat(size_t dim, double val)
- : n(dim), data(nullptr)
+ : n(dim), buf(nullptr)
 {
     if (n == 0) throw invalid_argument("size must be >0");
-    data = new double[n*n];
-    for (size_t i = 0; i < n*n; ++i) data[i] = val;
+    buf = mem::alloc(n*n, "ctor");
+    touch_rows(n, buf, [&](size_t, double* r) { std::fill(r, r + n, val); });
 }
 
 SquareMat::SquareMat(size_t dim, const double* raw)
- : n(dim), data(nullptr)
+ : n(dim), buf(nullptr)
 {
     if (n == 0) throw invalid_argument("size must be >0");
-    data = new double[n*n];
-    for (size_t i = 0; i < n*n; ++i) data[i] = raw[i];
+    buf = mem::alloc(n*n, "ctor");
+    touch_rows(n, buf, [&](size_t i, double* r) { std::copy(raw + i*n, raw + (i+1)*n, r); });
 }
 
 SquareMat::SquareMat(const SquareMat& o) { copy_from(o); }
 
 SquareMat& SquareMat::operator=(const SquareMat& o) {
     if (this != &o) {
-        delete[] data;
+        release();
         copy_from(o);
     }
     return *this;
 }
 
 SquareMat::~SquareMat() {
-    delete[] data;
+    release();
 }
 
 SquareMat SquareMat::from_string(const std::string& spec) {
-    std::string tmp = spec;
-    for (char& c : tmp) if (c == ',') c = ' ';
-    std::stringstream ss(tmp);
+    SQUAREMAT_TRACE_SPAN("parse", spec.size());
+    const char* const begin = spec.data();
+    const char* const end   = begin + spec.size();
 
-    double x; size_t count = 0;
-    while (ss >> x) ++count;
-    if (count == 0) throw invalid_argument("empty spec");
+    // Only the first row is scanned ahead (no number parsing) to size the matrix.
+    bool has_comma;
+    size_t first = count_first_row(begin, end, has_comma);
+    if (first == 0) {
+        if (skip_ws(begin, end) == end) throw invalid_argument("empty spec");
+        parse_error("empty row", skip_ws(begin, end), begin);
+    }
 
-    size_t dim = static_cast<size_t>(std::sqrt(count));
-    if (dim*dim != count) throw invalid_argument("not a square count");
+    // Legacy flat form "a b c d" (no row separators) must hold a square count.
+    size_t dim = first;
+    if (!has_comma) {
+        dim = static_cast<size_t>(std::sqrt(static_cast<double>(first)));
+        while (dim*dim > first) --dim;
+        while ((dim+1)*(dim+1) <= first) ++dim;
+        if (dim*dim != first) throw invalid_argument("not a square count");
+    }
 
-    ss.clear(); ss.seekg(0);
     SquareMat M(dim);
-    for (size_t i = 0; i < count; ++i) ss >> M.data[i];
+    double* out = M.buf;
+    const size_t per_row = has_comma ? dim : dim*dim;
+    const size_t rows    = has_comma ? dim : 1;
+
+    const char* p = begin;
+    for (size_t r = 0; r < rows; ++r) {
+        const char* row_start = skip_ws(p, end);
+        for (size_t c = 0; c < per_row; ++c) {
+            p = skip_ws(p, end);
+            if (p == end || *p == ',')
+                parse_error("row " + std::to_string(r) + " has " + std::to_string(c) +
+                            " values, expected " + std::to_string(per_row), row_start, begin);
+            const char* num = p;
+            // from_chars rejects a leading '+'; drop it only when a digit
+            // follows so "+-3" stays an error.
+            if (*num == '+' && num+1 != end &&
+                (std::isdigit(static_cast<unsigned char>(num[1])) || num[1] == '.'))
+                ++num;
+            auto res = std::from_chars(num, end, *out++);
+            if (res.ec != std::errc() ||
+                (res.ptr != end && *res.ptr != ',' &&
+                 !std::isspace(static_cast<unsigned char>(*res.ptr))))
+                parse_error("invalid number", p, begin);
+            p = res.ptr;
+        }
+        p = skip_ws(p, end);
+        if (p != end && *p != ',')
+            parse_error("row " + std::to_string(r) + " has more than " +
+                        std::to_string(per_row) + " values", p, begin);
+        if (r+1 < rows) {
+            if (p == end)
+                parse_error("expected " + std::to_string(rows) + " rows, got " +
+                            std::to_string(r+1), p, begin);
+            ++p;
+        }
+    }
+
+    // A single trailing separator is tolerated.
+    if (p != end) p = skip_ws(p+1, end);
+    if (p != end)
+        parse_error("expected " + std::to_string(rows) + " rows, got more", p, begin);
     return M;
 }
 
 double SquareMat::determinant_gauss() const {
+    SQUAREMAT_SCOPE("lu", n);
     if (n == 0) return 1.0;
-    double* tmp = new double[n*n];
-    for (size_t i = 0; i < n*n; ++i) tmp[i] = data[i];
-
-    double det = 1.0;
-    for (size_t k = 0; k < n; ++k) {
-        size_t piv = k;
-        for (size_t i = k+1; i < n; ++i)
-            if (std::fabs(tmp[i*n + k]) > std::fabs(tmp[piv*n + k]))
-                piv = i;
-        if (std::fabs(tmp[piv*n + k]) < 1e-12) { det = 0; break; }
-        if (piv != k) {
-            for (size_t j = 0; j < n; ++j)
-                std::swap(tmp[k*n+j], tmp[piv*n+j]);
-            det = -det;
-        }
-        det *= tmp[k*n + k];
-        double inv = 1.0 / tmp[k*n + k];
-        for (size_t j = k; j < n; ++j) tmp[k*n + j] *= inv;
-        for (size_t i = k+1; i < n; ++i) {
-            double factor = tmp[i*n + k];
-            for (size_t j = k; j < n; ++j)
-                tmp[i*n+j] -= factor * tmp[k*n+j];
-        }
-    }
-    delete[] tmp;
-    return det;
+    mem::Scratch scratch(n*n, "lu_scratch");
+    double* tmp = scratch.get();
+    for (size_t i = 0; i < n*n; ++i) tmp[i] = buf[i];
+    return kern::lu_det(n, tmp, n);
 }
 
-SquareMat& SquareMat::operator++()    { for (size_t i = 0; i < n*n; ++i) ++data[i]; return *this; }
+SquareMat& SquareMat::operator++()    { detach(); for (size_t i = 0; i < n*n; ++i) ++buf[i]; return *this; }
 SquareMat  SquareMat::operator++(int) { SquareMat t(*this); ++(*this); return t; }
-SquareMat& SquareMat::operator--()    { for (size_t i = 0; i < n*n; ++i) --data[i]; return *this; }
+SquareMat& SquareMat::operator--()    { detach(); for (size_t i = 0; i < n*n; ++i) --buf[i]; return *this; }
 SquareMat  SquareMat::operator--(int) { SquareMat t(*this); --(*this); return t; }
 
 SquareMat SquareMat::operator~() const {
+    SQUAREMAT_SCOPE("transpose", n);
     SquareMat r(n);
-    for (size_t i = 0; i < n; ++i)
-        for (size_t j = 0; j < n; ++j)
-            r.cell(j,i) = cell(i,j);
+    kern::transpose(n, buf, n, r.buf, n);
     return r;
 }
 
 double SquareMat::operator!() const {
+    SQUAREMAT_SCOPE("det", n);
+    const Structure st = structure();
+    if (st.kind == Structure::Diagonal || st.kind == Structure::Upper || st.kind == Structure::Lower) {
+        double d = 1.0;
+        for (size_t i = 0; i < n; ++i) d *= buf[i*n + i];
+        return d;
+    }
+    if (st.kind == Structure::Banded) return determinant_band(st.lower, st.upper);
+    // SPD matrices take the Cholesky path (half the flops); the O(n²)
+    // screen rejects most others before any factorization work is done
+    if (n > 1 && Cholesky::maybe_spd(*this)) {
+        SquareMat L(*this);
+        double* l = L.data();   // detaches: a copy-on-write L would share buf
+        if (kern::cholesky(n, l, n)) {
+            double d = 1.0;
+            for (size_t i = 0; i < n; ++i) d *= l[i*n + i];
+            return d * d;
+        }
+    }
     return determinant_gauss();
 }
 
@@ -0,0 +1,329 @@
+/*  Author: <Thelet.Shevach@gmail.com
+ *  SquareMat_formats.cpp : .npy and MatrixMarket readers/writers.
+ */
+
+#include "SquareMat_formats.h"
+#include "SquareMat_instr.h"
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+using std::size_t;
+using std::invalid_argument;
+
+namespace {
+
+// largest n with n*n*sizeof(double) representable in size_t
+constexpr size_t kMaxSide = size_t(1) << (sizeof(size_t) * 4 - 2);
+
+// RAII FILE* handle
+struct File {
+    std::FILE* f;
+    File(const std::string& path, const char* mode) : f(std::fopen(path.c_str(), mode)) {
+        if (!f) throw std::runtime_error("cannot open " + path);
+    }
+    ~File() { if (f) std::fclose(f); }
+    File(const File&) = delete;
+    File& operator=(const File&) = delete;
+
+    void read(void* dst, size_t bytes) {
+        if (std::fread(dst, 1, bytes, f) != bytes) throw invalid_argument("truncated file");
+    }
+    void write(const void* src, size_t bytes) {
+        if (std::fwrite(src, 1, bytes, f) != bytes) throw std::runtime_error("write failed");
+    }
+    // bytes left after the current position; SIZE_MAX when not seekable
+    size_t remaining() {
+        long at = std::ftell(f);
+        if (at < 0 || std::fseek(f, 0, SEEK_END) != 0) return SIZE_MAX;
+        long size = std::ftell(f);
+        if (size < at || std::fseek(f, at, SEEK_SET) != 0) return SIZE_MAX;
+        return static_cast<size_t>(size - at);
+    }
+};
+
+bool host_little() {
+    const std::uint16_t one = 1;
+    unsigned char b;
+    std::memcpy(&b, &one, 1);
+    return b == 1;
+}
+
+void byteswap(unsigned char* p, size_t count, size_t width) {
+    for (size_t i = 0; i < count; ++i, p += width)
+        std::reverse(p, p + width);
+}
+
+void transpose_in_place(double* a, size_t n) {
+    for (size_t i = 0; i < n; ++i)
+        for (size_t j = i+1; j < n; ++j)
+            std::swap(a[i*n + j], a[j*n + i]);
+}
+
+// value of 'key' in the .npy header dict, as the raw text after the colon
+std::string npy_field(const std::string& hdr, const char* key) {
+    size_t k = hdr.find(std::string("'") + key + "'");
+    if (k == std::string::npos) throw invalid_argument(std::string("npy: missing ") + key);
+    size_t c = hdr.find(':', k);
+    if (c == std::string::npos) throw invalid_argument("npy: malformed header");
+    ++c;
+    while (c < hdr.size() && hdr[c] == ' ') ++c;
+    return hdr.substr(c);
+}
+
+std::string lower(std::string s) {
+    for (char& c : s) c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+    return s;
+}
+
+// whitespace tokenizer over an in-memory file
+struct Cursor {
+    const char* p;
+    const char* end;
+
+    void skip_ws() { while (p != end && std::isspace(static_cast<unsigned char>(*p))) ++p; }
+    std::string line() {
+        const char* b = p;
+        while (p != end && *p != '\n') ++p;
+        std::string s(b, p);
+        if (p != end) ++p;
+        return s;
+    }
+    template <class T> T number(const char* what) {
+        skip_ws();
+        if (p != end && *p == '+' && p+1 != end &&
+            (std::isdigit(static_cast<unsigned char>(p[1])) || p[1] == '.'))
+            ++p;
+        T v{};
+        auto r = std::from_chars(p, end, v);
+        if (r.ec != std::errc()) throw invalid_argument(std::string("mm: bad ") + what);
+        p = r.ptr;
+        return v;
+    }
+};
+
+} // namespace
+
+namespace mat {
+
+//─── .npy ───────────────────────────────────────────────────
+
+SquareMat load_npy(const std::string& path) {
+    SQUAREMAT_TRACE_SPAN("load_npy", 0);
+    File in(path, "rb");
+    unsigned char pre[10];
+    in.read(pre, sizeof pre);
+    if (std::memcmp(pre, "\x93NUMPY", 6) != 0) throw invalid_argument("npy: bad magic");
+
+    size_t hlen;
+    if (pre[6] == 1) {
+        hlen = pre[8] | (size_t(pre[9]) << 8);
+    } else if (pre[6] == 2 || pre[6] == 3) {
+        unsigned char more[2];
+        in.read(more, 2);
+        hlen = pre[8] | (size_t(pre[9]) << 8) | (size_t(more[0]) << 16) | (size_t(more[1]) << 24);
+    } else {
+        throw invalid_argument("npy: unsupported version");
+    }
+    std::string hdr(hlen, '\0');
+    in.read(&hdr[0], hlen);
+
+    std::string descr = npy_field(hdr, "descr");
+    if (descr.size() < 5 || descr[0] != '\'' || descr[2] != 'f')
+        throw invalid_argument("npy: unsupported dtype");
+    const char   endian = descr[1];
+    const size_t width  = descr[3] == '8' ? 8 : descr[3] == '4' ? 4 : 0;
+    if (width == 0 || descr[4] != '\'') throw invalid_argument("npy: unsupported dtype");
+    const bool swap = (endian == '<' && !host_little()) || (endian == '>' && host_little());
+
+    const bool fortran = npy_field(hdr, "fortran_order").compare(0, 4, "True") == 0;
+
+    std::string shape = npy_field(hdr, "shape");
+    size_t dims[2] = {0, 0}, nd = 0;
+    const char* p = shape.c_str() + 1;
+    const char* e = shape.c_str() + shape.size();
+    while (p < e && *p != ')') {
+        if (std::isdigit(static_cast<unsigned char>(*p))) {
+            if (nd == 2) throw invalid_argument("npy: expected a 2-D array");
+            auto r = std::from_chars(p, e, dims[nd++]);
+            if (r.ec != std::errc()) throw invalid_argument("npy: bad shape");
+            p = r.ptr;
+        } else {
+            ++p;
+        }
+    }
+    if (nd != 2 || dims[0] != dims[1]) throw invalid_argument("npy: array is not square");
+    // n*n*8 must not wrap, and the payload has to be in the file before
+    // anything is allocated for it
+    if (dims[0] > kMaxSide) throw invalid_argument("npy: array too large");
+    if (dims[0] * dims[0] * width > in.remaining()) throw invalid_argument("truncated file");
+
+    SquareMat M(1);
+    M.reshape(dims[0]);
+    const size_t count = M.n * M.n;
+    unsigned char* raw = reinterpret_cast<unsigned char*>(M.buf);
+    if (width == 8) {
+        in.read(raw, count * 8);
+        if (swap) byteswap(raw, count, 8);
+    } else {
+        // floats land in the upper half of the buffer, then widen front-to-back
+        unsigned char* src = raw + count * 4;
+        in.read(src, count * 4);
+        if (swap) byteswap(src, count, 4);
+        for (size_t i = 0; i < count; ++i) {
+            float f;
+            std::memcpy(&f, src + i*4, 4);
+            M.buf[i] = f;
+        }
+    }
+    if (fortran) transpose_in_place(M.buf, M.n);
+    return M;
+}
+
+void save_npy(const SquareMat& m, const std::string& path, NpyType type, NpyOrder order) {
+    SQUAREMAT_TRACE_SPAN("save_npy", m.size());
+    const size_t n = m.n;
+    std::string dict = std::string("{'descr': '") + (host_little() ? '<' : '>') +
+                       (type == NpyType::Float64 ? "f8" : "f4") + "', 'fortran_order': " +
+                       (order == NpyOrder::Fortran ? "True" : "False") + ", 'shape': (" +
+                       std::to_string(n) + ", " + std::to_string(n) + "), }";
+    size_t total = 10 + dict.size() + 1;
+    dict.append((64 - total % 64) % 64, ' ');
+    dict.push_back('\n');
+
+    unsigned char pre[10] = {0x93, 'N', 'U', 'M', 'P', 'Y', 1, 0,
+                             static_cast<unsigned char>(dict.size() & 0xff),
+                             static_cast<unsigned char>(dict.size() >> 8)};
+    File out(path, "wb");
+    out.write(pre, sizeof pre);
+    out.write(dict.data(), dict.size());
+
+    if (type == NpyType::Float64 && order == NpyOrder::C) {
+        out.write(m.buf, n*n * sizeof(double));
+        return;
+    }
+    // convert one output line (row or column) at a time
+    const size_t width = type == NpyType::Float64 ? 8 : 4;
+    unsigned char* line = new unsigned char[n * width];
+    try {
+        for (size_t i = 0; i < n; ++i) {
+            for (size_t j = 0; j < n; ++j) {
+                double v = order == NpyOrder::C ? m.buf[i*n + j] : m.buf[j*n + i];
+                if (width == 8) { std::memcpy(line + j*8, &v, 8); }
+                else            { float f = static_cast<float>(v); std::memcpy(line + j*4, &f, 4); }
+            }
+            out.write(line, n * width);
+        }
+    } catch (...) { delete[] line; throw; }
+    delete[] line;
+}
+
+//─── MatrixMarket ───────────────────────────────────────────
+
+SquareMat load_mm(const std::string& path) {
+    SQUAREMAT_TRACE_SPAN("load_mm", 0);
+    std::string text;
+    {
+        File in(path, "rb");
+        char chunk[1 << 16];
+        size_t got;
+        while ((got = std::fread(chunk, 1, sizeof chunk, in.f)) > 0) text.append(chunk, got);
+    }
+    Cursor cur{text.data(), text.data() + text.size()};
+
+    std::string banner = lower(cur.line());
+    char obj[32] = {}, fmt[32] = {}, field[32] = {}, sym[32] = {};
+    if (std::sscanf(banner.c_str(), "%%%%matrixmarket %31s %31s %31s %31s", obj, fmt, field, sym) != 4 ||
+        std::strcmp(obj, "matrix") != 0)
+        throw invalid_argument("mm: bad banner");
+    const bool coord   = std::strcmp(fmt, "coordinate") == 0;
+    const bool pattern = std::strcmp(field, "pattern") == 0;
+    if (!coord && std::strcmp(fmt, "array") != 0) throw invalid_argument("mm: unknown format");
+    if (!pattern && std::strcmp(field, "real") != 0 && std::strcmp(field, "integer") != 0 &&
+        std::strcmp(field, "double") != 0)
+        throw invalid_argument("mm: unsupported field");
+    const bool symm = std::strcmp(sym, "symmetric") == 0;
+    const bool skew = std::strcmp(sym, "skew-symmetric") == 0;
+    if (!symm && !skew && std::strcmp(sym, "general") != 0)
+        throw invalid_argument("mm: unsupported symmetry");
+
+    for (;;) {
+        cur.skip_ws();
+        if (cur.p == cur.end || *cur.p != '%') break;
+        cur.line();
+    }
+    size_t rows = cur.number<size_t>("size"), cols = cur.number<size_t>("size");
+    if (rows != cols || rows == 0) throw invalid_argument("mm: matrix is not square");
+    const size_t n = rows;
+    SquareMat M(n, 0.0);
+
+    if (coord) {
+        size_t nnz = cur.number<size_t>("size");
+        for (size_t k = 0; k < nnz; ++k) {
+            size_t i = cur.number<size_t>("index"), j = cur.number<size_t>("index");
+            if (i == 0 || j == 0 || i > n || j > n) throw invalid_argument("mm: index out of range");
+            double v = pattern ? 1.0 : cur.number<double>("value");
+            --i; --j;
+            M.buf[i*n + j] = v;
+            if (i != j && (symm || skew)) M.buf[j*n + i] = skew ? -v : v;
+        }
+    } else {
+        if (pattern) throw invalid_argument("mm: pattern requires coordinate format");
+        // column-major; symmetric variants list the lower triangle only
+        for (size_t j = 0; j < n; ++j)
+            for (size_t i = (symm ? j : skew ? j+1 : 0); i < n; ++i) {
+                double v = cur.number<double>("value");
+                M.buf[i*n + j] = v;
+                if (symm || skew) M.buf[j*n + i] = skew ? -v : v;
+            }
+    }
+    return M;
+}
+
+void save_mm(const SquareMat& m, const std::string& path, MMFormat fmt) {
+    SQUAREMAT_TRACE_SPAN("save_mm", m.size());
+    const size_t n = m.n;
+    File out(path, "wb");
+    std::string buf;
+    buf.reserve(1 << 16);
+    auto flush = [&] { out.write(buf.data(), buf.size()); buf.clear(); };
+    auto put = [&](double v) {
+        char tmp[32];
+        buf.append(tmp, std::to_chars(tmp, tmp + sizeof tmp, v).ptr);
+    };
+    auto put_index = [&](size_t v) {
+        char tmp[24];
+        buf.append(tmp, std::to_chars(tmp, tmp + sizeof tmp, v).ptr);
+    };
+
+    if (fmt == MMFormat::Array) {
+        buf += "%%MatrixMarket matrix array real general\n";
+        put_index(n); buf += ' '; put_index(n); buf += '\n';
+        for (size_t j = 0; j < n; ++j)
+            for (size_t i = 0; i < n; ++i) {
+                put(m.buf[i*n + j]); buf += '\n';
+                if (buf.size() >= (1 << 16) - 64) flush();
+            }
+    } else {
+        size_t nnz = 0;
+        for (size_t i = 0; i < n*n; ++i) nnz += m.buf[i] != 0.0;
+        buf += "%%MatrixMarket matrix coordinate real general\n";
+        put_index(n); buf += ' '; put_index(n); buf += ' '; put_index(nnz); buf += '\n';
+        for (size_t j = 0; j < n; ++j)
+            for (size_t i = 0; i < n; ++i) {
+                double v = m.buf[i*n + j];
+                if (v == 0.0) continue;
+                put_index(i+1); buf += ' '; put_index(j+1); buf += ' '; put(v); buf += '\n';
+                if (buf.size() >= (1 << 16) - 96) flush();
+            }
+    }
+    flush();
+}
+
+} // namespace mat
@@ -0,0 +1,279 @@
+/*  Author: <Thelet.Shevach@gmail.com
+ *  SquareMat_graph.cpp : expression graph construction and concurrent evaluation.
+ */
+
+#include "SquareMat_graph.h"
+#include "SquareMat_instr.h"
+#include "SquareMat_kernels.h"
+#include "SquareMat_pool.h"
+#include <cmath>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <memory>
+#include <stdexcept>
+#include <utility>
+
+using std::size_t;
+using std::invalid_argument;
+
+namespace mat {
+
+//─── Handles ────────────────────────────────────────────────
+
+size_t Expr::size() const { return g->nodes[id].n; }
+
+SquareMat Expr::eval() const {
+    g->run({id});
+    return *g->nodes[id].m;
+}
+
+double Scalar::eval() const {
+    g->run({id});
+    return g->nodes[id].s;
+}
+
+//─── Construction ───────────────────────────────────────────
+
+size_t Graph::add_node(Node nd) {
+    nodes.push_back(std::move(nd));
+    return nodes.size() - 1;
+}
+
+Expr Graph::input(const SquareMat& m) {
+    Node nd{Op::Input};
+    nd.n = m.size();
+    nd.m = std::make_unique<SquareMat>(m);
+    nd.known = nd.pinned = true;
+    return Expr(this, add_node(std::move(nd)));
+}
+
+Scalar Graph::constant(double v) {
+    Node nd{Op::Const};
+    nd.s = v;
+    nd.known = nd.pinned = true;
+    return Scalar(this, add_node(std::move(nd)));
+}
+
+Expr Graph::matrix(Op op, Expr a, Expr b, double s) {
+    if (a.g != b.g) throw invalid_argument("operands belong to different graphs");
+    const size_t n = a.size();
+    if (b.size() != n) throw invalid_argument("size mismatch");
+    Node nd{op};
+    nd.a = a.id; nd.b = b.id; nd.n = n; nd.s = s;
+    return Expr(a.g, a.g->add_node(std::move(nd)));
+}
+
+Scalar Graph::scalar(Op op, Scalar a, Scalar b) {
+    if (a.g != b.g) throw invalid_argument("operands belong to different graphs");
+    Node nd{op};
+    nd.a = a.id; nd.b = b.id;
+    return Scalar(a.g, a.g->add_node(std::move(nd)));
+}
+
+Scalar Graph::det_of(Expr a) {
+    Node nd{Op::Det};
+    nd.a = nd.b = a.id;
+    return Scalar(a.g, a.g->add_node(std::move(nd)));
+}
+
+Expr Graph::pow_of(Expr a, unsigned int p) {
+    if (p == 0) {
+        SquareMat I(a.size(), 0.0);
+        for (size_t i = 0; i < a.size(); ++i) I.data()[i*a.size() + i] = 1.0;
+        return a.g->input(I);
+    }
+    // same square-and-multiply as operator^; each step is its own node
+    std::optional<Expr> res;
+    Expr base = a;
+    for (; p; p >>= 1) {
+        if (p & 1) res = res ? *res * base : base;
+        if (p > 1) base = base * base;
+    }
+    return *res;
+}
+
+Expr   operator+(Expr a, Expr b)           { return Graph::matrix(Graph::Op::Add, a, b); }
+Expr   operator-(Expr a, Expr b)           { return Graph::matrix(Graph::Op::Sub, a, b); }
+Expr   operator*(Expr a, Expr b)           { return Graph::matrix(Graph::Op::Mul, a, b); }
+Expr   operator*(Expr a, double s)         { return Graph::matrix(Graph::Op::Scale, a, a, s); }
+Expr   operator~(Expr a)                   { return Graph::matrix(Graph::Op::Transpose, a, a); }
+Expr   operator^(Expr a, unsigned int p)   { return Graph::pow_of(a, p); }
+Scalar operator!(Expr a)                   { return Graph::det_of(a); }
+Scalar operator+(Scalar a, Scalar b)       { return Graph::scalar(Graph::Op::SAdd, a, b); }
+Scalar operator-(Scalar a, Scalar b)       { return Graph::scalar(Graph::Op::SSub, a, b); }
+Scalar operator*(Scalar a, Scalar b)       { return Graph::scalar(Graph::Op::SMul, a, b); }
+Scalar operator/(Scalar a, Scalar b)       { return Graph::scalar(Graph::Op::SDiv, a, b); }
+
+//─── Evaluation ─────────────────────────────────────────────
+
+void Graph::eval(const std::vector<Expr>& ms, const std::vector<Scalar>& ss) {
+    std::vector<size_t> ids;
+    for (const Expr& e : ms) {
+        if (e.g != this) throw invalid_argument("node belongs to a different graph");
+        ids.push_back(e.id);
+    }
+    for (const Scalar& e : ss) {
+        if (e.g != this) throw invalid_argument("node belongs to a different graph");
+        ids.push_back(e.id);
+    }
+    run(ids);
+}
+
+void Graph::compute(Node& nd, SquareMat* out) {
+    const size_t n = nd.n;
+    auto in = [&](size_t id) -> const SquareMat& { return *nodes[id].m; };
+    switch (nd.op) {
+    case Op::Mul:
+        gemm(1.0, in(nd.a), in(nd.b), 0.0, *out);
+        break;
+    case Op::Add: {
+        SQUAREMAT_SCOPE("add", n);
+        kern::add(n, in(nd.a).data(), n, in(nd.b).data(), n, out->wbuf(), n);
+        break;
+    }
+    case Op::Sub: {
+        SQUAREMAT_SCOPE("sub", n);
+        kern::sub(n, in(nd.a).data(), n, in(nd.b).data(), n, out->wbuf(), n);
+        break;
+    }
+    case Op::Scale:
+        kern::scale(n, in(nd.a).data(), n, nd.s, out->wbuf(), n);
+        break;
+    case Op::Transpose: {
+        SQUAREMAT_SCOPE("transpose", n);
+        kern::transpose(n, in(nd.a).data(), n, out->wbuf(), n);
+        break;
+    }
+    case Op::Det:  nd.s = !in(nd.a);                        break;
+    case Op::SAdd: nd.s = nodes[nd.a].s + nodes[nd.b].s;    break;
+    case Op::SSub: nd.s = nodes[nd.a].s - nodes[nd.b].s;    break;
+    case Op::SMul: nd.s = nodes[nd.a].s * nodes[nd.b].s;    break;
+    case Op::SDiv:
+        if (std::fabs(nodes[nd.b].s) < 1e-12) throw invalid_argument("division by zero");
+        nd.s = nodes[nd.a].s / nodes[nd.b].s;
+        break;
+    case Op::Input:
+    case Op::Const:
+        break;
+    }
+}
+
+void Graph::run(const std::vector<size_t>& targets) {
+    // the unknown nodes the targets depend on
+    std::vector<char>   need(nodes.size(), 0);
+    std::vector<size_t> order, stack(targets);
+    while (!stack.empty()) {
+        const size_t id = stack.back();
+        stack.pop_back();
+        if (need[id] || nodes[id].known) continue;
+        need[id] = 1;
+        order.push_back(id);
+        stack.push_back(nodes[id].a);
+        stack.push_back(nodes[id].b);
+    }
+    for (size_t id : targets) nodes[id].pinned = true;
+    if (order.empty()) return;
+
+    struct Slot {
+        size_t              pending = 0;   // operands still to be computed
+        size_t              uses    = 0;   // consumers that have not run yet
+        std::vector<size_t> consumers;
+    };
+    std::vector<Slot> slot(nodes.size());
+    auto operands = [&](size_t id) {
+        const Node& nd = nodes[id];
+        const bool leaf = nd.op == Op::Input || nd.op == Op::Const;
+        std::vector<size_t> ops;
+        if (!leaf) ops.push_back(nd.a);
+        if (!leaf && nd.b != nd.a) ops.push_back(nd.b);
+        return ops;
+    };
+    std::vector<size_t> roots;
+    for (size_t id : order) {
+        for (size_t o : operands(id)) {
+            if (!need[o]) continue;
+            ++slot[id].pending;
+            ++slot[o].uses;
+            slot[o].consumers.push_back(id);
+        }
+        if (slot[id].pending == 0) roots.push_back(id);
+    }
+
+    // a TaskGroup rather than a blocking wait: run() may itself be called
+    // from a pool task (even on a one-worker pool), and joining runs ready
+    // nodes on this thread instead of sleeping on them
+    std::mutex         mtx;
+    std::exception_ptr error;
+    TaskGroup          tg(pool ? *pool : ThreadPool::instance());
+
+    std::function<void(size_t)> exec = [&](size_t id) {
+        Node& nd = nodes[id];
+        const bool is_matrix = nd.op == Op::Add || nd.op == Op::Sub || nd.op == Op::Mul
+                            || nd.op == Op::Scale || nd.op == Op::Transpose;
+        std::unique_ptr<SquareMat> out;
+        std::exception_ptr       err;
+        if (is_matrix) {
+            std::lock_guard<std::mutex> lk(mtx);
+            for (size_t k = spare.size(); k-- > 0;) {
+                if (spare[k]->size() != nd.n) continue;
+                out = std::move(spare[k]);
+                spare[k] = std::move(spare.back());
+                spare.pop_back();
+                ++st.buffers_reused;
+                break;
+            }
+        }
+        try {
+            if (is_matrix && !out) {
+                out = std::make_unique<SquareMat>(nd.n, 0.0);
+                out->enable_cow();                      // eval() copies share it
+                std::lock_guard<std::mutex> lk(mtx);
+                ++st.buffers_created;
+            }
+            compute(nd, out.get());
+        } catch (...) {
+            err = std::current_exception();
+        }
+
+        std::vector<size_t> ready;
+        {
+            std::lock_guard<std::mutex> lk(mtx);
+            if (err) {
+                if (!error) error = err;
+                err = nullptr;                        // drop our reference before run() rethrows
+                if (out) spare.push_back(std::move(out));
+            } else {
+                if (out) nd.m = std::move(out);
+                nd.known = true;
+                ++st.nodes_run;
+                for (size_t o : operands(id)) {
+                    Node& src = nodes[o];
+                    if (!need[o] || src.pinned || --slot[o].uses > 0) continue;
+                    if (src.m) spare.push_back(std::move(src.m));   // last consumer has run
+                    src.known = false;
+                }
+                if (!error)
+                    for (size_t c : slot[id].consumers)
+                        if (--slot[c].pending == 0) ready.push_back(c);
+            }
+        }
+        // forked before this task ends, so the group never drains early
+        for (size_t c : ready) tg.run([&exec, c] { exec(c); });
+    };
+
+    for (size_t id : roots) tg.run([&exec, id] { exec(id); });
+    tg.wait();
+
+    // after a failure, intermediates that did run still hold buffers
+    for (size_t id : order) {
+        Node& nd = nodes[id];
+        if (nd.pinned || !nd.known) continue;
+        if (nd.m) spare.push_back(std::move(nd.m));
+        nd.known = false;
+    }
+    if (error) std::rethrow_exception(error);
+}
+
+} // namespace mat
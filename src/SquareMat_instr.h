@@ -0,0 +1,141 @@
+/*  Author: <Thelet.Shevach@gmail.com
+ *  SquareMat_instr.h : internal instrumentation scopes placed around kernels.
+ *  Disabled cost is two relaxed atomic loads per scope (three with
+ *  SQUAREMAT_TRACE compiled in) and zeroing its forked-counter block.
+ */
+#ifndef SQUARE_MAT_INSTR_H
+#define SQUARE_MAT_INSTR_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace mat {
+namespace mem {
+namespace detail {
+
+extern std::atomic<bool>              on;
+extern thread_local const char*       current_op;   // innermost scope, for attribution
+
+} // namespace detail
+} // namespace mem
+
+namespace trace {
+namespace detail {
+
+extern std::atomic<bool> on;
+std::uint64_t now_ns();
+void record(const char* name, std::size_t n, std::uint64_t start_ns, std::uint64_t end_ns);
+
+/// one timeline span (only compiled in with SQUAREMAT_TRACE)
+class Span {
+    const char*   name;
+    std::size_t   n;
+    std::uint64_t start = 0;
+    bool          active;
+public:
+    Span(const char* what, std::size_t dim)
+        : name(what), n(dim), active(on.load(std::memory_order_relaxed)) { if (active) start = now_ns(); }
+    ~Span() { if (active) record(name, n, start, now_ns()); }
+    Span(const Span&)            = delete;
+    Span& operator=(const Span&) = delete;
+};
+
+} // namespace detail
+} // namespace trace
+
+namespace perf {
+namespace detail {
+
+extern std::atomic<bool> on;
+
+struct Sample {
+    std::uint64_t ns = 0;
+    std::uint64_t counters[5] = {};
+    bool          hw = false;
+};
+
+/// Counter deltas of pool tasks forked while a Scope is active; workers add
+/// theirs here so the scope's entry covers the whole operator.
+struct Forked {
+    std::atomic<std::uint64_t> counters[5] = {};
+    std::atomic<bool>          hw{true};
+};
+extern thread_local Forked* current;   // innermost active Scope on this thread
+
+void begin(Sample& s);
+void end(const char* op, std::size_t n, const Sample& s, const Forked& forked);
+void add(Forked& to, const Sample& s);  // this thread's deltas since s
+
+class Scope {
+    const char* op;
+    std::size_t n;
+    Sample      s;
+    bool        active;
+    const char* outer = nullptr;       // mem attribution to restore
+    bool        tagged;
+    Forked      forked;
+    Forked*     outer_forked = nullptr;
+#ifdef SQUAREMAT_TRACE
+    trace::detail::Span span{op, n};
+#endif
+public:
+    Scope(const char* name, std::size_t dim)
+        : op(name), n(dim), active(on.load(std::memory_order_relaxed)),
+          tagged(mem::detail::on.load(std::memory_order_relaxed)) {
+        if (tagged) { outer = mem::detail::current_op; mem::detail::current_op = name; }
+        if (active) { outer_forked = current; current = &forked; begin(s); }
+    }
+    ~Scope() {
+        if (active) {
+            end(op, n, s, forked);
+            current = outer_forked;
+            // an enclosing scope counts this thread itself, not our workers
+            if (outer_forked)
+                for (int i = 0; i < 5; ++i)
+                    outer_forked->counters[i].fetch_add(forked.counters[i].load(std::memory_order_relaxed),
+                                                       std::memory_order_relaxed);
+        }
+        if (tagged) mem::detail::current_op = outer;
+    }
+    Scope(const Scope&)            = delete;
+    Scope& operator=(const Scope&) = delete;
+};
+
+/** Wraps one pool task forked under `to` (captured by TaskGroup::run). A
+ *  no-op when nothing was active or when the forking thread runs the task
+ *  itself, since its own Scope already counts it. */
+class TaskCounters {
+    Forked* to;
+    Forked* outer;
+    Sample  s;
+public:
+    explicit TaskCounters(Forked* sink) : to(sink != current ? sink : nullptr), outer(current) {
+        if (to) { current = to; begin(s); }
+    }
+    ~TaskCounters() {
+        if (to) { add(*to, s); current = outer; }
+    }
+    TaskCounters(const TaskCounters&)            = delete;
+    TaskCounters& operator=(const TaskCounters&) = delete;
+};
+
+} // namespace detail
+} // namespace perf
+} // namespace mat
+
+#define SQUAREMAT_CAT2(a, b) a##b
+#define SQUAREMAT_CAT(a, b)  SQUAREMAT_CAT2(a, b)
+/// Instrument the rest of the enclosing block as operator `name` on size n.
+#define SQUAREMAT_SCOPE(name, n) \
+    ::mat::perf::detail::Scope SQUAREMAT_CAT(squaremat_scope_, __LINE__)(name, n)
+
+/// Timeline span only (no counters or attribution), e.g. around pool chunks.
+#ifdef SQUAREMAT_TRACE
+#define SQUAREMAT_TRACE_SPAN(name, n) \
+    ::mat::trace::detail::Span SQUAREMAT_CAT(squaremat_span_, __LINE__)(name, n)
+#else
+#define SQUAREMAT_TRACE_SPAN(name, n) ((void)0)
+#endif
+
+#endif // SQUARE_MAT_INSTR_H
@@ -3,16 +3,65 @@
  */
 
 #include "SquareMat.h"
+#include "SquareMat_instr.h"
+#include <charconv>
+#include <cstdio>
+#include <cerrno>
 #include <iostream>
 #include <stdexcept>
+#include <unistd.h>
+
+namespace {
+
+constexpr std::size_t kChunk   = 1 << 16;  // flush threshold (bytes)
+constexpr std::size_t kMaxCell = 32;       // longest to_chars double + separator
+
+// Format rows into a stack buffer with shortest round-trip to_chars,
+// handing off full chunks to `flush(const char*, size_t)`.
+template <class Flush>
+void format_rows(const double* data, std::size_t n, Flush flush) {
+    SQUAREMAT_SCOPE("write", n);
+    char buf[kChunk + kMaxCell];
+    std::size_t len = 0;
+    for (std::size_t i = 0; i < n; ++i) {
+        const double* row = data + i*n;
+        for (std::size_t j = 0; j < n; ++j) {
+            auto res = std::to_chars(buf + len, buf + len + kMaxCell - 1, row[j]);
+            len = static_cast<std::size_t>(res.ptr - buf);
+            buf[len++] = (j+1 < n ? ' ' : '\n');
+            if (len >= kChunk) { flush(buf, len); len = 0; }
+        }
+    }
+    if (len) flush(buf, len);
+}
+
+} // namespace
 
 namespace mat {
 
+void SquareMat::write_text(std::FILE* f) const {
+    format_rows(buf, n, [f](const char* p, std::size_t len) {
+        if (std::fwrite(p, 1, len, f) != len) throw std::runtime_error("write failed");
+    });
+}
+
+void SquareMat::write_text(int fd) const {
+    format_rows(buf, n, [fd](const char* p, std::size_t len) {
+        while (len) {
+            ssize_t w = ::write(fd, p, len);
+            if (w < 0) {
+                if (errno == EINTR) continue;
+                throw std::runtime_error("write failed");
+            }
+            p += w; len -= static_cast<std::size_t>(w);
+        }
+    });
+}
+
 std::ostream& operator<<(std::ostream& out, const SquareMat& m) {
-    for (size_t i = 0; i < m.size(); ++i) {
-        for (size_t j = 0; j < m.size(); ++j)
-            out << m[i][j] << (j+1<m.size()? ' ' : '\n');
-    }
+    format_rows(m.buf, m.n, [&out](const char* p, std::size_t len) {
+        out.write(p, static_cast<std::streamsize>(len));
+    });
     return out;
 }
 
@@ -21,7 +70,7 @@ std::istream& operator>>(std::istream& in, SquareMat& m) {
     if (!(in>>dim)) throw std::invalid_argument("failed to read dimension");
     SquareMat tmp(dim);
     for (size_t i=0;i<dim*dim;++i) {
-        if (!(in>>tmp.data[i])) throw std::invalid_argument("failed to read data");
+        if (!(in>>tmp.buf[i])) throw std::invalid_argument("failed to read data");
     }
     m = std::move(tmp);
     return in;
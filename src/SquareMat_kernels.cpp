@@ -0,0 +1,182 @@
+/*  Author: <Thelet.Shevach@gmail.com
+ *  SquareMat_kernels.cpp : strided element-wise, product and transpose kernels.
+ */
+
+#include "SquareMat_kernels.h"
+#include "SquareMat_pool.h"
+#include <cmath>
+#include <functional>
+#include <limits>
+#include <utility>
+
+namespace mat {
+namespace kern {
+
+namespace {
+
+constexpr size_t kTile     = 32;    // transpose tile edge
+constexpr size_t kParTile  = 64;    // transpose tile per task (parallel path)
+constexpr size_t kParDim   = 256;   // transpose / LU update go parallel from here
+constexpr size_t kLuGrain  = 32;    // LU trailing-update rows per task
+constexpr size_t kPoll = 16;   // lu_det pivots between cancellation checks
+
+template <class Op>
+void zip(size_t n, const double* a, size_t lda, const double* b, size_t ldb,
+         double* c, size_t ldc, Op op) {
+    for (size_t i = 0; i < n; ++i) {
+        const double* ar = a + i*lda;
+        const double* br = b + i*ldb;
+        double*       cr = c + i*ldc;
+        for (size_t j = 0; j < n; ++j) cr[j] = op(ar[j], br[j]);
+    }
+}
+
+} // namespace
+
+void add(size_t n, const double* a, size_t lda, const double* b, size_t ldb, double* c, size_t ldc) {
+    zip(n, a, lda, b, ldb, c, ldc, std::plus<double>());
+}
+void sub(size_t n, const double* a, size_t lda, const double* b, size_t ldb, double* c, size_t ldc) {
+    zip(n, a, lda, b, ldb, c, ldc, std::minus<double>());
+}
+void hadamard(size_t n, const double* a, size_t lda, const double* b, size_t ldb, double* c, size_t ldc) {
+    zip(n, a, lda, b, ldb, c, ldc, std::multiplies<double>());
+}
+
+void scale(size_t n, const double* a, size_t lda, double s, double* c, size_t ldc) {
+    for (size_t i = 0; i < n; ++i)
+        for (size_t j = 0; j < n; ++j) c[i*ldc + j] = a[i*lda + j] * s;
+}
+
+void copy(size_t n, const double* a, size_t lda, double* c, size_t ldc) {
+    for (size_t i = 0; i < n; ++i)
+        for (size_t j = 0; j < n; ++j) c[i*ldc + j] = a[i*lda + j];
+}
+
+void gemm_acc(size_t n, const double* a, size_t lda, const double* b, size_t ldb, double* c, size_t ldc) {
+    // i-k-j order: the inner loop streams rows of b and c
+    for (size_t i = 0; i < n; ++i) {
+        double* cr = c + i*ldc;
+        for (size_t k = 0; k < n; ++k) {
+            const double  aik = a[i*lda + k];
+            const double* br  = b + k*ldb;
+            for (size_t j = 0; j < n; ++j) cr[j] += aik * br[j];
+        }
+    }
+}
+
+void gemm_band_acc(size_t n, const double* a, size_t lda, size_t akl, size_t aku,
+                   const double* b, size_t ldb, size_t bkl, size_t bku, double* c, size_t ldc) {
+    for (size_t i = 0; i < n; ++i) {
+        double* cr = c + i*ldc;
+        const size_t k0 = i > akl ? i - akl : 0;
+        const size_t k1 = i + aku < n - 1 ? i + aku : n - 1;
+        for (size_t k = k0; k <= k1; ++k) {
+            const double aik = a[i*lda + k];
+            if (aik == 0.0) continue;
+            const size_t j0 = k > bkl ? k - bkl : 0;
+            const size_t j1 = k + bku < n - 1 ? k + bku : n - 1;
+            const double* br = b + k*ldb;
+            for (size_t j = j0; j <= j1; ++j) cr[j] += aik * br[j];
+        }
+    }
+}
+
+void gemm_row(size_t n, size_t i, const double* arow, size_t ainc, size_t akl, size_t aku,
+              const double* b, size_t ldb, bool tb, size_t bkl, size_t bku, double* out) {
+    const size_t k0 = i > akl ? i - akl : 0;
+    const size_t k1 = i + aku < n - 1 ? i + aku : n - 1;
+    if (!tb) {  // axpy over rows of b
+        for (size_t k = k0; k <= k1; ++k) {
+            const double aik = arow[k*ainc];
+            if (aik == 0.0) continue;
+            const size_t j0 = k > bkl ? k - bkl : 0;
+            const size_t j1 = k + bku < n - 1 ? k + bku : n - 1;
+            const double* br = b + k*ldb;
+            for (size_t j = j0; j <= j1; ++j) out[j] += aik * br[j];
+        }
+        return;
+    }
+    // bᵀ: out[j] = row i · row j of b; op(b)(k,j) is nonzero for k in [j-bku, j+bkl]
+    for (size_t j = 0; j < n; ++j) {
+        const size_t lo = j > bku ? j - bku : 0;
+        const size_t hi = j + bkl < n - 1 ? j + bkl : n - 1;
+        const size_t s0 = lo > k0 ? lo : k0, s1 = hi < k1 ? hi : k1;
+        const double* br = b + j*ldb;
+        double s = 0.0;
+        for (size_t k = s0; k <= s1; ++k) s += arow[k*ainc] * br[k];
+        out[j] += s;
+    }
+}
+
+double lu_det(size_t n, double* a, size_t lda, const std::atomic<bool>* stop) {
+    double det = 1.0;
+    for (size_t k = 0; k < n; ++k) {
+        if (stop && k % kPoll == 0 && stop->load(std::memory_order_relaxed))
+            return std::numeric_limits<double>::quiet_NaN();
+        size_t piv = k;
+        for (size_t i = k+1; i < n; ++i)
+            if (std::fabs(a[i*lda + k]) > std::fabs(a[piv*lda + k]))
+                piv = i;
+        if (std::fabs(a[piv*lda + k]) < 1e-12) return 0.0;
+        if (piv != k) {
+            for (size_t j = 0; j < n; ++j)
+                std::swap(a[k*lda + j], a[piv*lda + j]);
+            det = -det;
+        }
+        det *= a[k*lda + k];
+        double inv = 1.0 / a[k*lda + k];
+        for (size_t j = k; j < n; ++j) a[k*lda + j] *= inv;
+        auto update = [=](size_t lo, size_t hi) {
+            for (size_t i = lo; i < hi; ++i) {
+                double factor = a[i*lda + k];
+                for (size_t j = k; j < n; ++j)
+                    a[i*lda + j] -= factor * a[k*lda + j];
+            }
+        };
+        if (n - k - 1 < kParDim) update(k+1, n);
+        else                     parallel_for(k+1, n, kLuGrain, update);
+    }
+    return det;
+}
+
+void transpose(size_t n, const double* a, size_t lda, double* c, size_t ldc) {
+    if (a == c && lda == ldc) {
+        for (size_t i = 0; i < n; ++i)
+            for (size_t j = i+1; j < n; ++j) std::swap(c[i*ldc + j], c[j*ldc + i]);
+        return;
+    }
+    if (n >= kParDim) {   // recursive tiles: the halves are forked and stolen
+        parallel_for_2d(0, n, 0, n, kParTile, [=](size_t i0, size_t i1, size_t j0, size_t j1) {
+            for (size_t i = i0; i < i1; ++i)
+                for (size_t j = j0; j < j1; ++j) c[j*ldc + i] = a[i*lda + j];
+        });
+        return;
+    }
+    for (size_t ii = 0; ii < n; ii += kTile)
+        for (size_t jj = 0; jj < n; jj += kTile) {
+            const size_t ie = ii + kTile < n ? ii + kTile : n;
+            const size_t je = jj + kTile < n ? jj + kTile : n;
+            for (size_t i = ii; i < ie; ++i)
+                for (size_t j = jj; j < je; ++j) c[j*ldc + i] = a[i*lda + j];
+        }
+}
+
+bool overlap(size_t n, const double* a, size_t lda, const double* b, size_t ldb) {
+    const double* a_end = a + (n-1)*lda + n;
+    const double* b_end = b + (n-1)*ldb + n;
+    if (!(std::less<const double*>()(a, b_end) && std::less<const double*>()(b, a_end)))
+        return false;
+    if (lda != ldb) return true;            // conservative for unrelated layouts
+
+    // same parent layout: compare block coordinates (b relative to a)
+    if (std::less<const double*>()(b, a)) std::swap(a, b);
+    const size_t d  = static_cast<size_t>(b - a);
+    const size_t dr = d / lda, dc = d % lda;
+    // b starts dc columns right of a on row dr, or (lda-dc) columns left on row dr+1
+    if (dr < n && dc < n) return true;
+    return dr + 1 < n && lda - dc < n;
+}
+
+} // namespace kern
+} // namespace mat
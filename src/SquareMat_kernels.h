@@ -0,0 +1,53 @@
+/*  Author: <Thelet.Shevach@gmail.com
+ *  SquareMat_kernels.h : internal strided kernels shared by SquareMat and views.
+ *  Every matrix is n×n, row-major, with rows `ld` elements apart.
+ */
+#ifndef SQUARE_MAT_KERNELS_H
+#define SQUARE_MAT_KERNELS_H
+
+#include <atomic>
+#include <cstddef>
+
+namespace mat {
+namespace kern {
+
+using std::size_t;
+
+void add     (size_t n, const double* a, size_t lda, const double* b, size_t ldb, double* c, size_t ldc);
+void sub     (size_t n, const double* a, size_t lda, const double* b, size_t ldb, double* c, size_t ldc);
+void hadamard(size_t n, const double* a, size_t lda, const double* b, size_t ldb, double* c, size_t ldc);
+void scale   (size_t n, const double* a, size_t lda, double s, double* c, size_t ldc);
+void copy    (size_t n, const double* a, size_t lda, double* c, size_t ldc);
+
+/// c += a*b  (c must not overlap a or b)
+void gemm_acc(size_t n, const double* a, size_t lda, const double* b, size_t ldb, double* c, size_t ldc);
+
+/// c += a*b skipping entries outside each operand's band (kl below, ku above
+/// the diagonal): O(n·(akl+aku+1)·(bkl+bku+1))
+void gemm_band_acc(size_t n, const double* a, size_t lda, size_t akl, size_t aku,
+                   const double* b, size_t ldb, size_t bkl, size_t bku, double* c, size_t ldc);
+
+/// out += row i of op(a)·op(b), where op(x) is x or xᵀ. The row is read from
+/// `arow` with elements `ainc` apart (a + i*lda, 1 for a; a + i, lda for aᵀ);
+/// kl/ku are the bands of op(a) and op(b) (n-1 for general). out must not
+/// overlap a or b.
+void gemm_row(size_t n, size_t i, const double* arow, size_t ainc, size_t akl, size_t aku,
+              const double* b, size_t ldb, bool tb, size_t bkl, size_t bku, double* out);
+
+/// c = aᵀ (c == a with equal ld transposes in place)
+void transpose(size_t n, const double* a, size_t lda, double* c, size_t ldc);
+
+/// determinant by partial-pivot elimination, destroying a; `stop` (if set)
+/// is polled between column blocks and returns NaN once raised
+double lu_det(size_t n, double* a, size_t lda, const std::atomic<bool>* stop = nullptr);
+
+/// in-place lower Cholesky (blocked, parallel); false if not positive definite
+bool cholesky(size_t n, double* a, size_t lda);
+
+/// true if the two n×n blocks share any memory
+bool overlap(size_t n, const double* a, size_t lda, const double* b, size_t ldb);
+
+} // namespace kern
+} // namespace mat
+
+#endif // SQUARE_MAT_KERNELS_H
@@ -3,8 +3,15 @@
  */
 
 #include "SquareMat.h"
+#include "SquareMat_kernels.h"
+#include "SquareMat_pool.h"
+#include "SquareMat_instr.h"
+#include "SquareMat_alloc.h"
+#include <algorithm>
 #include <cmath>
 #include <stdexcept>
+#include <utility>
+#include <vector>
 
 using std::size_t;
 using std::invalid_argument;
@@ -15,68 +22,88 @@ namespace mat {
 
 SquareMat SquareMat::operator+(const SquareMat& o) const {
     MATCH(o);
+    SQUAREMAT_SCOPE("add", n);
     SquareMat r(n);
-    for (size_t i = 0; i < n*n; ++i) r.data[i] = data[i] + o.data[i];
+    for (size_t i = 0; i < n*n; ++i) r.buf[i] = buf[i] + o.buf[i];
     return r;
 }
 
 SquareMat SquareMat::operator-(const SquareMat& o) const {
     MATCH(o);
+    SQUAREMAT_SCOPE("sub", n);
     SquareMat r(n);
-    for (size_t i = 0; i < n*n; ++i) r.data[i] = data[i] - o.data[i];
+    for (size_t i = 0; i < n*n; ++i) r.buf[i] = buf[i] - o.buf[i];
     return r;
 }
 
 SquareMat SquareMat::operator-() const {
     SquareMat r(n);
-    for (size_t i = 0; i < n*n; ++i) r.data[i] = -data[i];
+    for (size_t i = 0; i < n*n; ++i) r.buf[i] = -buf[i];
     return r;
 }
 
 SquareMat SquareMat::operator*(const SquareMat& o) const {
     MATCH(o);
+    SQUAREMAT_SCOPE("mul", n);
     SquareMat r(n,0.0);
-    for (size_t i=0;i<n;++i)
-        for (size_t k=0;k<n;++k) {
-            double a = cell(i,k);
-            for (size_t j=0;j<n;++j)
-                r.cell(i,j) += a * o.cell(k,j);
-        }
+    const Structure sa = structure(), sb = o.structure();
+    if (n >= 128) {   // rows split recursively on the work-stealing pool
+        const double* a = buf;
+        const double* b = o.buf;
+        double*       c = r.buf;
+        parallel_for(0, n, 16, [&](size_t lo, size_t hi) {
+            for (size_t i = lo; i < hi; ++i)
+                kern::gemm_row(n, i, a + i*n, 1, sa.lower, sa.upper, b, n, false, sb.lower, sb.upper, c + i*n);
+        });
+    } else if (sa.kind == Structure::General && sb.kind == Structure::General)
+        kern::gemm_acc(n, buf, n, o.buf, n, r.buf, n);
+    else    // diagonal O(n²), banded O(n·k²), triangular ~n³/6
+        kern::gemm_band_acc(n, buf, n, sa.lower, sa.upper, o.buf, n, sb.lower, sb.upper, r.buf, n);
     return r;
 }
 
 SquareMat SquareMat::operator*(double s) const {
     SquareMat r(n);
-    for (size_t i=0;i<n*n;++i) r.data[i] = data[i]*s;
+    for (size_t i=0;i<n*n;++i) r.buf[i] = buf[i]*s;
     return r;
 }
 
 SquareMat SquareMat::operator/(double s) const {
     if (std::fabs(s)<1e-12) throw invalid_argument("division by zero");
     SquareMat r(n);
-    for (size_t i=0;i<n*n;++i) r.data[i] = data[i]/s;
+    for (size_t i=0;i<n*n;++i) r.buf[i] = buf[i]/s;
     return r;
 }
 
 SquareMat SquareMat::operator%(const SquareMat& o) const {
     MATCH(o);
     SquareMat r(n);
-    for (size_t i=0;i<n*n;++i) r.data[i] = data[i]*o.data[i];
+    for (size_t i=0;i<n*n;++i) r.buf[i] = buf[i]*o.buf[i];
     return r;
 }
 
 SquareMat SquareMat::operator%(int k) const {
     SquareMat r(n);
-    for (size_t i=0;i<n*n;++i) r.data[i] = std::fmod(data[i], double(k));
+    for (size_t i=0;i<n*n;++i) r.buf[i] = std::fmod(buf[i], double(k));
     return r;
 }
 
 SquareMat SquareMat::operator^(unsigned int p) const {
+    SQUAREMAT_SCOPE("pow", n);
     if (p==0) {
         SquareMat id(n,0.0);
         for (size_t i=0;i<n;++i) id.cell(i,i)=1.0;
         return id;
     }
+    if (structure().kind == Structure::Diagonal) {   // O(n): power each diagonal entry
+        SquareMat r(n,0.0);
+        for (size_t i=0;i<n;++i) {
+            double b = cell(i,i), acc = 1.0;
+            for (unsigned int e = p; e; e >>= 1, b *= b) if (e&1) acc *= b;
+            r.cell(i,i) = acc;
+        }
+        return r;
+    }
     SquareMat base(*this), res=base; --p;
     while (p) {
         if (p&1) res=res*base;
@@ -89,46 +116,95 @@ SquareMat SquareMat::operator^(unsigned int p) const {
 // compound matrix-matrix
 SquareMat& SquareMat::operator+=(const SquareMat& o) {
     MATCH(o);
-    for (size_t i=0;i<n*n;++i) data[i]+=o.data[i];
+    detach();
+    for (size_t i=0;i<n*n;++i) buf[i]+=o.buf[i];
     return *this;
 }
 SquareMat& SquareMat::operator-=(const SquareMat& o) {
     MATCH(o);
-    for (size_t i=0;i<n*n;++i) data[i]-=o.data[i];
+    detach();
+    for (size_t i=0;i<n*n;++i) buf[i]-=o.buf[i];
     return *this;
 }
 SquareMat& SquareMat::operator*=(const SquareMat& o) {
     MATCH(o);
-    SquareMat tmp = (*this) * o;
-    return *this = tmp;
+    gemm(1.0, *this, o, 0.0, *this);
+    return *this;
 }
 SquareMat& SquareMat::operator%=(const SquareMat& o) {
     MATCH(o);
-    for (size_t i=0;i<n*n;++i) data[i]*=o.data[i];
+    detach();
+    for (size_t i=0;i<n*n;++i) buf[i]*=o.buf[i];
     return *this;
 }
 
 // compound scalar
 SquareMat& SquareMat::operator*=(double s) {
-    for (size_t i=0;i<n*n;++i) data[i]*=s;
+    detach();
+    for (size_t i=0;i<n*n;++i) buf[i]*=s;
     return *this;
 }
 SquareMat& SquareMat::operator/=(double s) {
     if (std::fabs(s)<1e-12) throw invalid_argument("division by zero");
-    for (size_t i=0;i<n*n;++i) data[i]/=s;
+    detach();
+    for (size_t i=0;i<n*n;++i) buf[i]/=s;
     return *this;
 }
 SquareMat& SquareMat::operator%=(int k) {
-    for (size_t i=0;i<n*n;++i) data[i]=std::fmod(data[i], double(k));
+    detach();
+    for (size_t i=0;i<n*n;++i) buf[i]=std::fmod(buf[i], double(k));
     return *this;
 }
 SquareMat& SquareMat::operator+=(double s) {
-    for (size_t i=0;i<n*n;++i) data[i]+=s;
+    detach();
+    for (size_t i=0;i<n*n;++i) buf[i]+=s;
     return *this;
 }
 SquareMat& SquareMat::operator-=(double s) {
-    for (size_t i=0;i<n*n;++i) data[i]-=s;
+    detach();
+    for (size_t i=0;i<n*n;++i) buf[i]-=s;
     return *this;
 }
 
+//─── GEMM ───────────────────────────────────────────────────
+
+void gemm(double alpha, const SquareMat& A, const SquareMat& B, double beta, SquareMat& C,
+          Trans ta, Trans tb) {
+    const size_t n = C.size();
+    SQUAREMAT_SCOPE("gemm", n);
+    if (A.size() != n || B.size() != n) throw invalid_argument("size mismatch");
+    double* c = C.wbuf();              // detaches a shared C before the alias checks
+    const double* a = A.data();
+    const double* b = B.data();
+
+    // row i of C needs row i of A but all of B (or all of A when transposed)
+    const bool   aliased = c == b || (c == a && ta == Trans::Yes);
+    mem::Scratch held(aliased ? n*n : 0, "gemm_alias");
+    if (aliased) {
+        std::copy(c, c + n*n, held.get());
+        if (c == a) a = held.get();
+        if (c == b) b = held.get();
+    }
+
+    auto sa = A.structure(), sb = B.structure();
+    if (ta == Trans::Yes) std::swap(sa.lower, sa.upper);
+    if (tb == Trans::Yes) std::swap(sb.lower, sb.upper);
+    const bool   at   = ta == Trans::Yes;
+    const size_t ainc = at ? n : 1;
+
+    auto rows = [&](size_t lo, size_t hi) {
+        std::vector<double> scratch(n);
+        for (size_t i = lo; i < hi; ++i) {
+            std::fill(scratch.begin(), scratch.end(), 0.0);
+            kern::gemm_row(n, i, at ? a + i : a + i*n, ainc, sa.lower, sa.upper,
+                           b, n, tb == Trans::Yes, sb.lower, sb.upper, scratch.data());
+            double* cr = c + i*n;
+            if (beta == 0.0) for (size_t j = 0; j < n; ++j) cr[j] = alpha * scratch[j];
+            else             for (size_t j = 0; j < n; ++j) cr[j] = beta * cr[j] + alpha * scratch[j];
+        }
+    };
+    if (n < 128) rows(0, n);
+    else         parallel_for(0, n, 16, rows);
+}
+
 } // namespace mat
@@ -0,0 +1,199 @@
+/*  Author: <Thelet.Shevach@gmail.com
+ *  SquareMat_mem.cpp : headed buffer allocation and per-site telemetry.
+ */
+
+#include "SquareMat_mem.h"
+#include "SquareMat_alloc.h"
+#include "SquareMat_instr.h"
+#include "SquareMat_numa.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <new>
+#include <utility>
+
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
+
+using std::size_t;
+using std::uint64_t;
+using std::int64_t;
+
+namespace mat {
+namespace mem {
+
+namespace detail {
+std::atomic<bool>        on{false};
+thread_local const char* current_op = nullptr;
+}
+
+namespace {
+
+constexpr std::uint32_t kUntracked = ~std::uint32_t(0);
+
+// 32 bytes in front of every buffer; keeps the payload 16-byte aligned
+struct Header {
+    size_t        bytes;
+    std::uint32_t tag;           // index into `entries`, or kUntracked
+    std::uint32_t generation;    // reset() bumps it; older buffers are ignored
+    uint64_t      born_ns;
+    uint64_t      mapped;        // length of an interleaved mapping, 0 = heap
+};
+static_assert(sizeof(Header) == 32);
+
+std::mutex                                         mtx;
+std::vector<Entry>                                 entries;
+std::map<std::pair<std::string, std::string>, std::uint32_t> index;
+Totals                                             total;
+std::uint32_t                                      generation = 0;
+
+uint64_t now_ns() {
+    return uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+void record_alloc(Header& h, const char* site) {
+    const char* op = detail::current_op ? detail::current_op : "-";
+    std::lock_guard<std::mutex> lock(mtx);
+    auto key = std::make_pair(std::string(op), std::string(site));
+    auto it  = index.find(key);
+    if (it == index.end()) {
+        it = index.emplace(key, std::uint32_t(entries.size())).first;
+        entries.push_back(Entry{key.first, key.second});
+    }
+    Entry& e = entries[it->second];
+    const int64_t b = int64_t(h.bytes);
+    ++e.allocs;      e.bytes += h.bytes;
+    e.live_bytes += b;     e.peak_bytes = std::max(e.peak_bytes, e.live_bytes);
+    ++total.allocs;  total.bytes += h.bytes;
+    total.live_bytes += b; total.peak_bytes = std::max(total.peak_bytes, total.live_bytes);
+    h.tag        = it->second;
+    h.generation = generation;
+    h.born_ns    = now_ns();
+}
+
+void record_free(const Header& h) {
+    const uint64_t life = now_ns() - h.born_ns;
+    std::lock_guard<std::mutex> lock(mtx);
+    if (h.generation != generation || h.tag >= entries.size()) return;
+    Entry& e = entries[h.tag];
+    ++e.frees;
+    e.live_bytes -= int64_t(h.bytes);
+    e.lifetime_ns += life;
+    e.max_lifetime_ns = std::max(e.max_lifetime_ns, life);
+    ++total.frees;
+    total.live_bytes -= int64_t(h.bytes);
+}
+
+std::string report_target;
+
+void report_at_exit() {
+    if (report_target == "1") { report(std::cerr); return; }
+    std::ofstream f(report_target);
+    if (f) report(f);
+}
+
+// SQUAREMAT_MEM switches recording on before main()
+const bool from_env = [] {
+    const char* v = std::getenv("SQUAREMAT_MEM");
+    if (!v || !*v || std::strcmp(v, "0") == 0) return false;
+    report_target = v;
+    detail::on.store(true, std::memory_order_relaxed);
+    std::atexit(report_at_exit);
+    return true;
+}();
+
+} // namespace
+
+double* alloc(size_t count, const char* site) {
+    const size_t bytes = count * sizeof(double);
+    Header* h = nullptr;
+#ifdef __linux__
+    // own mapping so the policy covers fresh pages and no neighbouring heap data
+    if (bytes >= numa::kMinBytes && numa::placement() == numa::Placement::Interleave) {
+        void* m = mmap(nullptr, sizeof(Header) + bytes, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (m != MAP_FAILED) {
+            numa::interleave(m, sizeof(Header) + bytes);
+            h = static_cast<Header*>(m);
+            h->mapped = sizeof(Header) + bytes;
+        }
+    }
+#endif
+    if (!h) {
+        h = static_cast<Header*>(::operator new(sizeof(Header) + bytes));
+        h->mapped = 0;
+    }
+    h->bytes = bytes;
+    h->tag   = kUntracked;
+    if (detail::on.load(std::memory_order_relaxed)) record_alloc(*h, site);
+    return reinterpret_cast<double*>(h + 1);
+}
+
+void free(double* p) noexcept {
+    if (!p) return;
+    Header* h = reinterpret_cast<Header*>(p) - 1;
+    if (h->tag != kUntracked) record_free(*h);
+#ifdef __linux__
+    if (h->mapped) { munmap(h, h->mapped); return; }
+#endif
+    ::operator delete(h);
+}
+
+void enable(bool on) { detail::on.store(on, std::memory_order_relaxed); }
+bool enabled()       { return detail::on.load(std::memory_order_relaxed); }
+
+std::vector<Entry> snapshot() {
+    std::lock_guard<std::mutex> lock(mtx);
+    std::vector<Entry> out(entries);
+    std::sort(out.begin(), out.end(), [](const Entry& a, const Entry& b) {
+        return a.op != b.op ? a.op < b.op : a.site < b.site;
+    });
+    return out;
+}
+
+Totals totals() {
+    std::lock_guard<std::mutex> lock(mtx);
+    return total;
+}
+
+void reset() {
+    std::lock_guard<std::mutex> lock(mtx);
+    for (Entry& e : entries) e = Entry{e.op, e.site};
+    total = Totals{};
+    ++generation;
+}
+
+void report(std::ostream& out) {
+    const std::vector<Entry> es = snapshot();
+    const Totals t = totals();
+    const std::ios::fmtflags flags = out.flags();
+    out << std::left << std::setw(12) << "op" << std::setw(14) << "site" << std::right
+        << std::setw(9) << "allocs" << std::setw(9) << "frees" << std::setw(12) << "KiB"
+        << std::setw(11) << "live KiB" << std::setw(11) << "peak KiB"
+        << std::setw(12) << "mean us" << std::setw(12) << "max us" << '\n' << std::fixed;
+    auto kib = [](double b) { return b / 1024.0; };
+    for (const Entry& e : es) {
+        if (!e.allocs) continue;
+        out << std::left << std::setw(12) << e.op << std::setw(14) << e.site << std::right
+            << std::setw(9) << e.allocs << std::setw(9) << e.frees << std::setprecision(1)
+            << std::setw(12) << kib(double(e.bytes)) << std::setw(11) << kib(double(e.live_bytes))
+            << std::setw(11) << kib(double(e.peak_bytes))
+            << std::setw(12) << (e.frees ? double(e.lifetime_ns) / double(e.frees) / 1e3 : 0.0)
+            << std::setw(12) << double(e.max_lifetime_ns) / 1e3 << '\n';
+    }
+    out << std::left << std::setw(26) << "total" << std::right << std::setw(9) << t.allocs
+        << std::setw(9) << t.frees << std::setprecision(1) << std::setw(12) << kib(double(t.bytes))
+        << std::setw(11) << kib(double(t.live_bytes)) << std::setw(11) << kib(double(t.peak_bytes)) << '\n';
+    out.flags(flags);
+}
+
+} // namespace mem
+} // namespace mat
@@ -0,0 +1,151 @@
+/*  Author: <Thelet.Shevach@gmail.com
+ *  SquareMat_numa.cpp : node topology from sysfs, mbind / get_mempolicy and
+ *  sched_setaffinity wrappers.
+ */
+
+#include "SquareMat_numa.h"
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#ifdef __linux__
+#include <linux/mempolicy.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+using std::size_t;
+
+namespace mat {
+namespace numa {
+
+namespace {
+
+std::atomic<Placement> current{[] {
+    const char* v = std::getenv("SQUAREMAT_NUMA");
+    return v && std::strcmp(v, "interleave") == 0 ? Placement::Interleave : Placement::FirstTouch;
+}()};
+
+/// "0-3,8,10-11" → {0,1,2,3,8,10,11}
+std::vector<int> parse_list(const std::string& s) {
+    std::vector<int> out;
+    const char* p = s.c_str();
+    while (*p) {
+        char* end;
+        long lo = std::strtol(p, &end, 10);
+        if (end == p) break;
+        long hi = lo;
+        p = end;
+        if (*p == '-') { hi = std::strtol(p + 1, &end, 10); p = end; }
+        for (long v = lo; v <= hi; ++v) out.push_back(int(v));
+        if (*p == ',') ++p;
+        else break;
+    }
+    return out;
+}
+
+std::string read_line(const std::string& path) {
+    std::ifstream in(path);
+    std::string line;
+    std::getline(in, line);
+    return line;
+}
+
+const std::vector<int>& online_nodes() {
+    static const std::vector<int> list = [] {
+        std::vector<int> v = parse_list(read_line("/sys/devices/system/node/online"));
+        if (v.empty()) v.push_back(0);
+        return v;
+    }();
+    return list;
+}
+
+#ifdef __linux__
+/// allowed CPUs of the first caller, interleaved across nodes
+const std::vector<int>& cpu_order() {
+    static const std::vector<int> order = [] {
+        cpu_set_t allowed;
+        CPU_ZERO(&allowed);
+        if (sched_getaffinity(0, sizeof allowed, &allowed) != 0) return std::vector<int>{};
+        std::vector<std::vector<int>> per_node;
+        for (int node : online_nodes()) {
+            std::vector<int> cpus;
+            for (int c : parse_list(read_line("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist")))
+                if (c >= 0 && c < CPU_SETSIZE && CPU_ISSET(c, &allowed)) cpus.push_back(c);
+            if (!cpus.empty()) per_node.push_back(std::move(cpus));
+        }
+        if (per_node.empty()) {                 // no sysfs topology: one node
+            per_node.emplace_back();
+            for (int c = 0; c < CPU_SETSIZE; ++c)
+                if (CPU_ISSET(c, &allowed)) per_node.back().push_back(c);
+        }
+        std::vector<int> out;
+        for (size_t i = 0;; ++i) {
+            bool any = false;
+            for (const auto& cpus : per_node)
+                if (i < cpus.size()) { out.push_back(cpus[i]); any = true; }
+            if (!any) break;
+        }
+        return out;
+    }();
+    return order;
+}
+#endif
+
+} // namespace
+
+void      set_placement(Placement p) { current.store(p, std::memory_order_relaxed); }
+Placement placement()                { return current.load(std::memory_order_relaxed); }
+
+size_t nodes() { return online_nodes().size(); }
+
+bool interleave(void* p, size_t bytes) {
+#if defined(__linux__) && defined(SYS_mbind)
+    const size_t page  = size_t(sysconf(_SC_PAGESIZE));
+    const auto   first = (reinterpret_cast<std::uintptr_t>(p) + page - 1) / page * page;
+    const auto   last  = (reinterpret_cast<std::uintptr_t>(p) + bytes) / page * page;
+    if (last <= first) return false;
+
+    constexpr size_t kBits = 8 * sizeof(unsigned long);
+    std::vector<unsigned long> mask(size_t(online_nodes().back()) / kBits + 1, 0);
+    for (int node : online_nodes()) mask[size_t(node) / kBits] |= 1UL << (size_t(node) % kBits);
+    return syscall(SYS_mbind, first, last - first, MPOL_INTERLEAVE, mask.data(),
+                   mask.size() * kBits + 1, MPOL_MF_MOVE) == 0;
+#else
+    (void)p; (void)bytes;
+    return false;
+#endif
+}
+
+int node_of(const void* p) {
+#if defined(__linux__) && defined(SYS_get_mempolicy)
+    int node = -1;
+    if (syscall(SYS_get_mempolicy, &node, nullptr, 0, p, MPOL_F_NODE | MPOL_F_ADDR) != 0) return -1;
+    return node;
+#else
+    (void)p;
+    return -1;
+#endif
+}
+
+bool pin_thread(size_t k) {
+#ifdef __linux__
+    const std::vector<int>& order = cpu_order();
+    if (order.empty()) return false;
+    cpu_set_t one;
+    CPU_ZERO(&one);
+    CPU_SET(order[k % order.size()], &one);
+    return sched_setaffinity(0, sizeof one, &one) == 0;
+#else
+    (void)k;
+    return false;
+#endif
+}
+
+} // namespace numa
+} // namespace mat
@@ -0,0 +1,223 @@
+/*  Author: <Thelet.Shevach@gmail.com
+ *  SquareMat_perf.cpp : perf_event_open counter groups, per-operator totals.
+ */
+
+#include "SquareMat_perf.h"
+#include "SquareMat_instr.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <utility>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+using std::size_t;
+using std::uint64_t;
+
+namespace mat {
+namespace perf {
+
+namespace detail {
+std::atomic<bool>    on{false};
+thread_local Forked* current = nullptr;
+}
+
+namespace {
+
+enum Counter { Cycles, Instructions, L1dMiss, LlcMiss, BranchMiss, kCounters };
+
+/// One counter group per thread, opened on first use and closed at thread exit.
+struct ThreadCounters {
+    int  fd[kCounters];
+    int  slot[kCounters];        // position in the group read, -1 if not opened
+    int  leader = -1;
+    int  opened = 0;
+    bool tried  = false;
+
+    ThreadCounters() { for (int i = 0; i < kCounters; ++i) fd[i] = slot[i] = -1; }
+    ~ThreadCounters() {
+#ifdef __linux__
+        for (int f : fd) if (f >= 0) close(f);
+#endif
+    }
+
+    void open_all() {
+        tried = true;
+#ifdef __linux__
+        auto cache = [](uint64_t level) {
+            return level | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+        };
+        const std::pair<uint32_t, uint64_t> ev[kCounters] = {
+            {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+            {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+            {PERF_TYPE_HW_CACHE, cache(PERF_COUNT_HW_CACHE_L1D)},
+            {PERF_TYPE_HW_CACHE, cache(PERF_COUNT_HW_CACHE_LL)},
+            {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+        };
+        for (int i = 0; i < kCounters; ++i) {
+            perf_event_attr attr;
+            std::memset(&attr, 0, sizeof attr);
+            attr.size           = sizeof attr;
+            attr.type           = ev[i].first;
+            attr.config         = ev[i].second;
+            attr.exclude_kernel = 1;
+            attr.exclude_hv     = 1;
+            attr.read_format    = PERF_FORMAT_GROUP;
+            const long f = syscall(SYS_perf_event_open, &attr, 0, -1, leader, 0);
+            if (f < 0) continue;                     // first success leads the group
+            fd[i] = int(f);
+            slot[i] = opened++;
+            if (leader < 0) leader = fd[i];
+        }
+#endif
+    }
+
+    bool read(uint64_t* out) {
+        if (!tried) open_all();
+        if (!opened) return false;
+#ifdef __linux__
+        uint64_t buf[1 + kCounters];
+        if (::read(leader, buf, sizeof buf) < ssize_t(sizeof(uint64_t) * (1 + opened))) return false;
+        for (int i = 0; i < kCounters; ++i) out[i] = slot[i] >= 0 ? buf[1 + slot[i]] : 0;
+        return true;
+#else
+        (void)out;
+        return false;
+#endif
+    }
+};
+
+thread_local ThreadCounters tls;
+
+std::mutex                                      mtx;
+std::map<std::pair<std::string, size_t>, Entry> totals;
+
+uint64_t now_ns() {
+    return uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+size_t size_class(size_t n) {
+    size_t c = 1;
+    while (c < n) c <<= 1;
+    return c;
+}
+
+std::string report_target;
+
+void report_at_exit() {
+    if (report_target == "1") { report(std::cerr); return; }
+    std::ofstream f(report_target);
+    if (f) report(f);
+}
+
+// SQUAREMAT_PERF switches recording on before main()
+const bool from_env = [] {
+    const char* v = std::getenv("SQUAREMAT_PERF");
+    if (!v || !*v || std::strcmp(v, "0") == 0) return false;
+    report_target = v;
+    detail::on.store(true, std::memory_order_relaxed);
+    std::atexit(report_at_exit);
+    return true;
+}();
+
+} // namespace
+
+namespace detail {
+
+void begin(Sample& s) {
+    s.hw = tls.read(s.counters);
+    s.ns = now_ns();
+}
+
+void end(const char* op, size_t n, const Sample& s, const Forked& forked) {
+    const uint64_t ns = now_ns() - s.ns;
+    uint64_t c[kCounters] = {};
+    const bool hw = s.hw && tls.read(c) && forked.hw.load(std::memory_order_relaxed);
+    for (int i = 0; i < kCounters; ++i) c[i] += forked.counters[i].load(std::memory_order_relaxed);
+
+    std::lock_guard<std::mutex> lock(mtx);
+    const size_t cls = size_class(n);
+    Entry& e = totals[{op, cls}];
+    if (e.calls == 0) { e.op = op; e.size_class = cls; e.hw = hw; }
+    ++e.calls;
+    e.ns += ns;
+    if (hw) {
+        e.cycles        += c[Cycles]       - s.counters[Cycles];
+        e.instructions  += c[Instructions] - s.counters[Instructions];
+        e.l1d_misses    += c[L1dMiss]      - s.counters[L1dMiss];
+        e.llc_misses    += c[LlcMiss]      - s.counters[LlcMiss];
+        e.branch_misses += c[BranchMiss]   - s.counters[BranchMiss];
+    }
+    e.hw = e.hw && hw;
+}
+
+void add(Forked& to, const Sample& s) {
+    uint64_t c[kCounters];
+    if (!s.hw || !tls.read(c)) {
+        to.hw.store(false, std::memory_order_relaxed);
+        return;
+    }
+    for (int i = 0; i < kCounters; ++i)
+        to.counters[i].fetch_add(c[i] - s.counters[i], std::memory_order_relaxed);
+}
+
+} // namespace detail
+
+void enable(bool on) { detail::on.store(on, std::memory_order_relaxed); }
+bool enabled()       { return detail::on.load(std::memory_order_relaxed); }
+
+bool available() {
+    uint64_t c[kCounters];
+    return tls.read(c);
+}
+
+std::vector<Entry> snapshot() {
+    std::lock_guard<std::mutex> lock(mtx);
+    std::vector<Entry> out;
+    for (const auto& kv : totals) out.push_back(kv.second);
+    return out;
+}
+
+void reset() {
+    std::lock_guard<std::mutex> lock(mtx);
+    totals.clear();
+}
+
+void report(std::ostream& out) {
+    const std::vector<Entry> es = snapshot();
+    const std::ios::fmtflags flags = out.flags();
+    out << std::left << std::setw(12) << "op" << std::right << std::setw(7) << "n<=" << std::setw(9) << "calls"
+        << std::setw(13) << "ns/call" << std::setw(14) << "cycles/call" << std::setw(7) << "IPC"
+        << std::setw(9) << "L1D/ki" << std::setw(9) << "LLC/ki" << std::setw(9) << "BR/ki" << '\n'
+        << std::fixed;
+    for (const Entry& e : es) {
+        const double calls = double(e.calls), ki = double(e.instructions) / 1000.0;
+        out << std::left << std::setw(12) << e.op << std::right << std::setw(7) << e.size_class
+            << std::setw(9) << e.calls << std::setprecision(0) << std::setw(13) << double(e.ns) / calls;
+        if (e.hw && e.cycles && ki > 0)
+            out << std::setw(14) << double(e.cycles) / calls << std::setprecision(2)
+                << std::setw(7)  << double(e.instructions) / double(e.cycles)
+                << std::setw(9)  << double(e.l1d_misses) / ki << std::setw(9) << double(e.llc_misses) / ki
+                << std::setw(9)  << double(e.branch_misses) / ki;
+        else
+            out << std::setw(14) << "-";
+        out << '\n';
+    }
+    out.flags(flags);
+}
+
+} // namespace perf
+} // namespace mat
@@ -0,0 +1,83 @@
+/*  Author: <Thelet.Shevach@gmail.com
+ *  SquareMat_pipeline.cpp : stage scheduling and the MatReader source stage.
+ */
+
+#include "SquareMat_pipeline.h"
+#include "SquareMat_pool.h"
+
+namespace mat {
+
+namespace {
+
+// group of the Pipeline::run() whose stage (or start-up) this thread is in
+thread_local TaskGroup* tl_stages = nullptr;
+
+struct InStages {
+    TaskGroup* outer;
+    explicit InStages(TaskGroup* tg) : outer(tl_stages) { tl_stages = tg; }
+    ~InStages() { tl_stages = outer; }
+};
+
+} // namespace
+
+namespace detail {
+
+void schedule(std::coroutine_handle<> h) {
+    if (TaskGroup* tg = tl_stages) {
+        // a resumed stage is still pending in the group, so it cannot drain early
+        tg->run([h, tg] { InStages in(tg); h.resume(); });
+        return;
+    }
+    ThreadPool::instance().submit([h] { h.resume(); });
+}
+
+} // namespace detail
+
+std::suspend_never Task::promise_type::final_suspend() noexcept {
+    if (owner) owner->stage_done(error);
+    return {};
+}
+
+void Pipeline::stage_done(std::exception_ptr e) noexcept {
+    std::lock_guard<std::mutex> lk(mtx);
+    if (e && !error) error = e;
+    if (--remaining == 0) cv.notify_all();
+}
+
+void Pipeline::run() {
+    std::vector<Task> batch = std::move(stages);
+    stages.clear();
+    {
+        std::lock_guard<std::mutex> lk(mtx);
+        remaining = batch.size();
+        error = nullptr;
+    }
+    TaskGroup tg(pool ? *pool : ThreadPool::instance());
+    {
+        InStages in(&tg);
+        for (Task& t : batch) {
+            auto h = std::exchange(t.h, {});
+            h.promise().owner = this;
+            detail::schedule(h);
+        }
+    }
+    tg.wait();
+    // only a stage woken from outside this pipeline can still be running
+    std::unique_lock<std::mutex> lk(mtx);
+    cv.wait(lk, [this] { return remaining == 0; });
+    if (error) std::rethrow_exception(std::exchange(error, nullptr));
+}
+
+Task source(MatReader& in, Channel<SquareMat>& out) {
+    try {
+        SquareMat m(1);
+        while (in.next(m))
+            if (!co_await out.push(m)) break;
+    } catch (...) {
+        out.abort();
+        throw;
+    }
+    out.close();
+}
+
+} // namespace mat
@@ -0,0 +1,283 @@
+/*  Author: <Thelet.Shevach@gmail.com
+ *  SquareMat_pool.cpp : work-stealing pool, fork/join groups and parallel loops.
+ */
+
+#include "SquareMat_pool.h"
+#include "SquareMat_instr.h"
+#include "SquareMat_numa.h"
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+
+using std::size_t;
+
+namespace {
+
+// pool and deque index of the current worker thread (null outside a pool)
+thread_local mat::ThreadPool* tl_pool  = nullptr;
+thread_local size_t           tl_index = 0;
+// group of the task this thread is running (null outside any group task)
+thread_local const mat::TaskGroup* tl_group = nullptr;
+
+// a sleeping joiner re-checks for stealable work this often
+constexpr auto kJoinPoll = std::chrono::microseconds(50);
+
+size_t default_threads() {
+    if (const char* env = std::getenv("SQUAREMAT_THREADS")) {
+        long v = std::strtol(env, nullptr, 10);
+        if (v > 0) return static_cast<size_t>(v);
+    }
+    unsigned hw = std::thread::hardware_concurrency();
+    return hw > 1 ? hw - 1 : 0;   // caller thread takes the remaining core
+}
+
+bool default_pin() {
+    const char* env = std::getenv("SQUAREMAT_PIN");
+    return env && *env && std::strcmp(env, "0") != 0;
+}
+
+} // namespace
+
+namespace mat {
+
+//─── ThreadPool ─────────────────────────────────────────────
+
+ThreadPool& ThreadPool::instance() {
+    static ThreadPool pool(default_threads(), default_pin());
+    return pool;
+}
+
+ThreadPool::ThreadPool(size_t threads, bool pin) {
+    local.reserve(threads);
+    for (size_t i = 0; i < threads; ++i) local.push_back(std::make_unique<Deque>());
+    workers.reserve(threads);
+    for (size_t i = 0; i < threads; ++i)
+        workers.emplace_back([this, i, pin] { worker_loop(i, pin); });
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lk(mtx);
+        stopping = true;
+    }
+    cv.notify_all();
+    for (auto& t : workers) t.join();
+}
+
+void ThreadPool::push(std::function<void()> task, TaskGroup* group) {
+    if (tl_pool == this) {
+        std::lock_guard<std::mutex> lk(local[tl_index]->mtx);
+        local[tl_index]->tasks.push_back({std::move(task), group});
+    } else {
+        std::lock_guard<std::mutex> lk(mtx);
+        queue.push_back({std::move(task), group});
+    }
+    {
+        // under mtx so a worker about to sleep cannot miss the increment
+        std::lock_guard<std::mutex> lk(mtx);
+        queued.fetch_add(1, std::memory_order_relaxed);
+    }
+    cv.notify_one();
+}
+
+bool ThreadPool::run_one(const TaskGroup* only) {
+    if (queued.load(std::memory_order_relaxed) == 0) return false;
+    auto eligible = [only](const Task& t) { return !only || (t.group && t.group->within(only)); };
+    // take the first eligible task scanning from the back (newest) or front
+    auto take = [&](std::deque<Task>& q, bool newest, Task& out) {
+        if (newest) {
+            for (auto it = q.end(); it != q.begin();) {
+                if (!eligible(*--it)) continue;
+                out = std::move(*it);
+                q.erase(it);
+                return true;
+            }
+        } else {
+            for (auto it = q.begin(); it != q.end(); ++it) {
+                if (!eligible(*it)) continue;
+                out = std::move(*it);
+                q.erase(it);
+                return true;
+            }
+        }
+        return false;
+    };
+
+    Task task{nullptr, nullptr};
+    bool found = false;
+    const bool   inside = tl_pool == this;
+    const size_t self   = inside ? tl_index : 0;
+    if (inside) {                                      // own deque, newest first
+        std::lock_guard<std::mutex> lk(local[self]->mtx);
+        found = take(local[self]->tasks, true, task);
+    }
+    if (!found) {                                      // work from outside
+        std::lock_guard<std::mutex> lk(mtx);
+        found = take(queue, false, task);
+    }
+    const size_t w = local.size();
+    const size_t start = inside ? self + 1 : victim.fetch_add(1, std::memory_order_relaxed);
+    for (size_t k = 0; !found && k < w; ++k) {         // steal the oldest
+        Deque& d = *local[(start + k) % w];
+        std::lock_guard<std::mutex> lk(d.mtx);
+        found = take(d.tasks, false, task);
+    }
+    if (!found) return false;
+    queued.fetch_sub(1, std::memory_order_relaxed);
+    struct Running {
+        const TaskGroup* outer;
+        explicit Running(const TaskGroup* g) : outer(tl_group) { tl_group = g; }
+        ~Running() { tl_group = outer; }
+    } running(task.group);
+    task.fn();
+    return true;
+}
+
+void ThreadPool::worker_loop(size_t self, bool pin) {
+    tl_pool  = this;
+    tl_index = self;
+    if (pin) numa::pin_thread(self);
+    for (;;) {
+        if (run_one(nullptr)) continue;
+        std::unique_lock<std::mutex> lk(mtx);
+        cv.wait(lk, [this] { return stopping || queued.load(std::memory_order_relaxed) > 0; });
+        if (stopping && queued.load(std::memory_order_relaxed) == 0) return;
+    }
+}
+
+void ThreadPool::submit(std::function<void()> task) {
+    if (workers.empty()) { task(); return; }
+    push(std::move(task), nullptr);
+}
+
+void ThreadPool::parallel_for(size_t begin, size_t end, size_t grain,
+                              const std::function<void(size_t, size_t)>& body) {
+    if (begin >= end) return;
+    if (grain == 0) grain = 1;
+    auto chunk = [&](size_t lo, size_t hi) {
+        SQUAREMAT_TRACE_SPAN("chunk", hi - lo);
+        body(lo, hi);
+    };
+    if (end - begin <= grain || workers.empty()) {
+        chunk(begin, end);
+        return;
+    }
+
+    TaskGroup tg(*this);
+    // fork the upper half (a whole number of chunks), keep splitting the lower
+    std::function<void(size_t, size_t)> split = [&](size_t lo, size_t hi) {
+        while (hi - lo > grain) {
+            const size_t chunks = (hi - lo + grain - 1) / grain;
+            const size_t mid    = lo + (chunks / 2) * grain;
+            tg.run([&split, mid, hi] { split(mid, hi); });
+            hi = mid;
+        }
+        chunk(lo, hi);
+    };
+    try {
+        split(begin, end);
+    } catch (...) {
+        tg.fail(std::current_exception());
+    }
+    tg.wait();
+}
+
+void ThreadPool::parallel_for_2d(size_t r0, size_t r1, size_t c0, size_t c1, size_t grain,
+                                 const std::function<void(size_t, size_t, size_t, size_t)>& body) {
+    if (r0 >= r1 || c0 >= c1) return;
+    if (grain == 0) grain = 1;
+    if ((r1 - r0 <= grain && c1 - c0 <= grain) || workers.empty()) {
+        // recursive tiles still help locality on a single thread
+        std::function<void(size_t, size_t, size_t, size_t)> tile =
+            [&](size_t a0, size_t a1, size_t b0, size_t b1) {
+                if (a1 - a0 <= grain && b1 - b0 <= grain) { body(a0, a1, b0, b1); return; }
+                if (a1 - a0 >= b1 - b0) { const size_t m = a0 + (a1 - a0) / 2; tile(a0, m, b0, b1); tile(m, a1, b0, b1); }
+                else                    { const size_t m = b0 + (b1 - b0) / 2; tile(a0, a1, b0, m); tile(a0, a1, m, b1); }
+            };
+        tile(r0, r1, c0, c1);
+        return;
+    }
+
+    TaskGroup tg(*this);
+    std::function<void(size_t, size_t, size_t, size_t)> split =
+        [&](size_t a0, size_t a1, size_t b0, size_t b1) {
+            while (a1 - a0 > grain || b1 - b0 > grain) {
+                if (a1 - a0 >= b1 - b0) {
+                    const size_t m = a0 + (a1 - a0) / 2;
+                    tg.run([&split, m, a1, b0, b1] { split(m, a1, b0, b1); });
+                    a1 = m;
+                } else {
+                    const size_t m = b0 + (b1 - b0) / 2;
+                    tg.run([&split, a0, a1, m, b1] { split(a0, a1, m, b1); });
+                    b1 = m;
+                }
+            }
+            SQUAREMAT_TRACE_SPAN("chunk", (a1 - a0) * (b1 - b0));
+            body(a0, a1, b0, b1);
+        };
+    try {
+        split(r0, r1, c0, c1);
+    } catch (...) {
+        tg.fail(std::current_exception());
+    }
+    tg.wait();
+}
+
+//─── TaskGroup ──────────────────────────────────────────────
+
+TaskGroup::TaskGroup(ThreadPool& pool) : pool(pool), parent(tl_group) {}
+
+TaskGroup::~TaskGroup() {
+    try { wait(); } catch (...) {}
+}
+
+void TaskGroup::fail(std::exception_ptr e) {
+    std::lock_guard<std::mutex> lk(mtx);
+    if (!error) error = std::move(e);
+}
+
+bool TaskGroup::within(const TaskGroup* g) const {
+    // every ancestor outlives this group: it was created inside one of
+    // their tasks, and that task cannot finish before this group's wait()
+    for (const TaskGroup* t = this; t; t = t->parent)
+        if (t == g) return true;
+    return false;
+}
+
+void TaskGroup::run(std::function<void()> task) {
+    if (pool.size() == 0) {
+        try { task(); } catch (...) { fail(std::current_exception()); }
+        return;
+    }
+    pending.fetch_add(1, std::memory_order_relaxed);
+    // counters of the task go to the perf scope that forks it
+    pool.push([this, task = std::move(task), sink = perf::detail::current] {
+        try {
+            perf::detail::TaskCounters counted(sink);
+            task();
+        } catch (...) {
+            fail(std::current_exception());
+        }
+        // decrement under the lock: wait() may return (and the group
+        // vanish) as soon as it observes zero and takes the lock
+        std::lock_guard<std::mutex> lk(mtx);
+        if (pending.fetch_sub(1, std::memory_order_acq_rel) == 1) cv.notify_all();
+    }, this);
+}
+
+void TaskGroup::wait() {
+    while (pending.load(std::memory_order_acquire) > 0) {
+        if (pool.run_one(this)) continue;
+        // forked work is running elsewhere: sleep, but look for new work now and then
+        std::unique_lock<std::mutex> lk(mtx);
+        cv.wait_for(lk, kJoinPoll, [this] { return pending.load(std::memory_order_acquire) == 0; });
+    }
+    std::exception_ptr e;
+    {
+        std::lock_guard<std::mutex> lk(mtx);   // pairs with the last task's unlock
+        e = std::exchange(error, nullptr);
+    }
+    if (e) std::rethrow_exception(e);
+}
+
+} // namespace mat
@@ -0,0 +1,316 @@
+/*  Author: <Thelet.Shevach@gmail.com
+ *  SquareMat_sparse.cpp : CSR storage, SpMM and hash-accumulator SpGEMM.
+ */
+
+#include "SquareMat_sparse.h"
+#include "SquareMat_pool.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <numeric>
+#include <stdexcept>
+#include <utility>
+
+using std::size_t;
+using std::vector;
+using std::invalid_argument;
+
+namespace {
+
+constexpr size_t kRowGrain = 64;
+constexpr size_t kEmpty    = std::numeric_limits<size_t>::max();
+
+// One output row at a time; open addressing for short rows, a dense
+// scatter array once the row may cover a large share of the columns.
+class RowAccumulator {
+    size_t n;
+    vector<size_t> keys;  vector<double> hvals;    // hash table
+    vector<double> dense; vector<char>   seen;     // dense scatter
+    vector<size_t> touched;
+    bool use_dense = false;
+    size_t mask = 0;
+public:
+    explicit RowAccumulator(size_t dim) : n(dim) {}
+
+    void begin(size_t upper_bound) {
+        touched.clear();
+        use_dense = upper_bound * 4 > n;
+        if (use_dense) {
+            if (dense.empty()) { dense.assign(n, 0.0); seen.assign(n, 0); }
+            return;
+        }
+        size_t cap = 16;
+        while (cap < 2 * upper_bound) cap <<= 1;
+        if (keys.size() < cap) { keys.assign(cap, kEmpty); hvals.assign(cap, 0.0); }
+        mask = cap - 1;
+    }
+
+    void add(size_t col, double v) {
+        if (use_dense) {
+            if (!seen[col]) { seen[col] = 1; dense[col] = 0.0; touched.push_back(col); }
+            dense[col] += v;
+            return;
+        }
+        size_t h = (col * 0x9E3779B97F4A7C15ull) & mask;
+        while (keys[h] != kEmpty && keys[h] != col) h = (h + 1) & mask;
+        if (keys[h] == kEmpty) { keys[h] = col; hvals[h] = 0.0; touched.push_back(h); }
+        hvals[h] += v;
+    }
+
+    // append the row (sorted by column) and reset the touched slots
+    size_t flush(vector<size_t>& cols, vector<double>& vals) {
+        const size_t start = cols.size();
+        if (use_dense) {
+            std::sort(touched.begin(), touched.end());
+            for (size_t c : touched) { cols.push_back(c); vals.push_back(dense[c]); seen[c] = 0; }
+        } else {
+            for (size_t slot : touched) { cols.push_back(keys[slot]); vals.push_back(hvals[slot]); keys[slot] = kEmpty; }
+            // sort the new (col,val) pairs by column
+            vector<size_t> order(cols.size() - start);
+            std::iota(order.begin(), order.end(), start);
+            std::sort(order.begin(), order.end(), [&](size_t a, size_t b) { return cols[a] < cols[b]; });
+            vector<size_t> c2(order.size()); vector<double> v2(order.size());
+            for (size_t i = 0; i < order.size(); ++i) { c2[i] = cols[order[i]]; v2[i] = vals[order[i]]; }
+            std::copy(c2.begin(), c2.end(), cols.begin() + static_cast<std::ptrdiff_t>(start));
+            std::copy(v2.begin(), v2.end(), vals.begin() + static_cast<std::ptrdiff_t>(start));
+        }
+        return cols.size() - start;
+    }
+};
+
+} // namespace
+
+namespace mat {
+
+SparseSquareMat::SparseSquareMat(size_t dim) : n(dim), rowp(dim + 1, 0) {
+    if (n == 0) throw invalid_argument("size must be >0");
+}
+
+SparseSquareMat::SparseSquareMat(const SquareMat& m, double drop_tol) : n(m.size()), rowp(n + 1, 0) {
+    const double* a = m.data();
+    for (size_t i = 0; i < n; ++i) {
+        for (size_t j = 0; j < n; ++j) {
+            const double v = a[i*n + j];
+            if (std::fabs(v) > drop_tol) { cols.push_back(j); vals.push_back(v); }
+        }
+        rowp[i + 1] = cols.size();
+    }
+}
+
+SparseSquareMat SparseSquareMat::from_triplets(size_t dim, const vector<Triplet>& t) {
+    SparseSquareMat S(dim);
+    vector<size_t> order(t.size());
+    std::iota(order.begin(), order.end(), 0);
+    for (const Triplet& e : t)
+        if (e.row >= dim || e.col >= dim) throw invalid_argument("triplet index out of range");
+    std::sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+        return t[a].row != t[b].row ? t[a].row < t[b].row : t[a].col < t[b].col;
+    });
+    for (size_t k = 0; k < order.size(); ++k) {
+        const Triplet& e = t[order[k]];
+        if (k && t[order[k-1]].row == e.row && t[order[k-1]].col == e.col) { S.vals.back() += e.val; continue; }
+        S.cols.push_back(e.col);
+        S.vals.push_back(e.val);
+        ++S.rowp[e.row + 1];
+    }
+    for (size_t i = 0; i < dim; ++i) S.rowp[i + 1] += S.rowp[i];
+    return S;
+}
+
+SparseSquareMat SparseSquareMat::identity(size_t dim) {
+    SparseSquareMat S(dim);
+    S.cols.resize(dim);
+    S.vals.assign(dim, 1.0);
+    for (size_t i = 0; i < dim; ++i) { S.cols[i] = i; S.rowp[i + 1] = i + 1; }
+    return S;
+}
+
+double SparseSquareMat::operator()(size_t r, size_t c) const {
+    if (r >= n || c >= n) throw invalid_argument("index out of range");
+    auto b = cols.begin() + static_cast<std::ptrdiff_t>(rowp[r]);
+    auto e = cols.begin() + static_cast<std::ptrdiff_t>(rowp[r + 1]);
+    auto it = std::lower_bound(b, e, c);
+    return it != e && *it == c ? vals[static_cast<size_t>(it - cols.begin())] : 0.0;
+}
+
+SquareMat SparseSquareMat::to_dense() const {
+    SquareMat M(n, 0.0);
+    double* m = M.data();
+    for (size_t i = 0; i < n; ++i)
+        for (size_t k = rowp[i]; k < rowp[i + 1]; ++k) m[i*n + cols[k]] = vals[k];
+    return M;
+}
+
+//─── CSC / transpose ────────────────────────────────────────
+
+void SparseSquareMat::build_csc() {
+    csc_colp.assign(n + 1, 0);
+    csc_rows.resize(nnz());
+    csc_vals.resize(nnz());
+    for (size_t c : cols) ++csc_colp[c + 1];
+    for (size_t j = 0; j < n; ++j) csc_colp[j + 1] += csc_colp[j];
+    vector<size_t> next(csc_colp.begin(), csc_colp.end() - 1);
+    for (size_t i = 0; i < n; ++i)
+        for (size_t k = rowp[i]; k < rowp[i + 1]; ++k) {
+            const size_t dst = next[cols[k]]++;
+            csc_rows[dst] = i;
+            csc_vals[dst] = vals[k];
+        }
+}
+
+void SparseSquareMat::drop_csc() {
+    csc_colp.clear(); csc_rows.clear(); csc_vals.clear();
+    csc_colp.shrink_to_fit(); csc_rows.shrink_to_fit(); csc_vals.shrink_to_fit();
+}
+
+SparseSquareMat SparseSquareMat::operator~() const {
+    SparseSquareMat T(n);
+    if (has_csc()) {                   // CSC of A is exactly CSR of Aᵀ
+        T.rowp = csc_colp; T.cols = csc_rows; T.vals = csc_vals;
+        return T;
+    }
+    SparseSquareMat tmp(*this);
+    tmp.build_csc();
+    T.rowp.swap(tmp.csc_colp); T.cols.swap(tmp.csc_rows); T.vals.swap(tmp.csc_vals);
+    return T;
+}
+
+//─── Element-wise ───────────────────────────────────────────
+
+template <class Op>
+SparseSquareMat SparseSquareMat::merge(const SparseSquareMat& o, Op op, bool intersect) const {
+    if (n != o.n) throw invalid_argument("size mismatch");
+    SparseSquareMat R(n);
+    R.cols.reserve(intersect ? std::min(nnz(), o.nnz()) : nnz() + o.nnz());
+    R.vals.reserve(R.cols.capacity());
+    for (size_t i = 0; i < n; ++i) {
+        size_t a = rowp[i], ae = rowp[i + 1], b = o.rowp[i], be = o.rowp[i + 1];
+        while (a < ae || b < be) {
+            if (b == be || (a < ae && cols[a] < o.cols[b])) {
+                if (!intersect) { R.cols.push_back(cols[a]); R.vals.push_back(op(vals[a], 0.0)); }
+                ++a;
+            } else if (a == ae || o.cols[b] < cols[a]) {
+                if (!intersect) { R.cols.push_back(o.cols[b]); R.vals.push_back(op(0.0, o.vals[b])); }
+                ++b;
+            } else {
+                R.cols.push_back(cols[a]); R.vals.push_back(op(vals[a], o.vals[b]));
+                ++a; ++b;
+            }
+        }
+        R.rowp[i + 1] = R.cols.size();
+    }
+    return R;
+}
+
+SparseSquareMat SparseSquareMat::operator+(const SparseSquareMat& o) const {
+    return merge(o, [](double a, double b) { return a + b; }, false);
+}
+SparseSquareMat SparseSquareMat::operator-(const SparseSquareMat& o) const {
+    return merge(o, [](double a, double b) { return a - b; }, false);
+}
+SparseSquareMat SparseSquareMat::operator%(const SparseSquareMat& o) const {
+    return merge(o, [](double a, double b) { return a * b; }, true);
+}
+
+SparseSquareMat SparseSquareMat::operator*(double s) const {
+    SparseSquareMat R(*this);
+    R.drop_csc();
+    for (double& v : R.vals) v *= s;
+    return R;
+}
+
+//─── Products ───────────────────────────────────────────────
+
+SquareMat SparseSquareMat::operator*(const SquareMat& B) const {
+    if (n != B.size()) throw invalid_argument("size mismatch");
+    SquareMat C(n, 0.0);
+    const double* b = B.data();
+    double*       c = C.data();
+    parallel_for(0, n, kRowGrain, [&](size_t lo, size_t hi) {
+        for (size_t i = lo; i < hi; ++i) {
+            double* ci = c + i*n;
+            for (size_t k = rowp[i]; k < rowp[i + 1]; ++k) {
+                const double  a  = vals[k];
+                const double* bk = b + cols[k]*n;
+                for (size_t j = 0; j < n; ++j) ci[j] += a * bk[j];
+            }
+        }
+    });
+    return C;
+}
+
+SquareMat operator*(const SquareMat& A, const SparseSquareMat& S) {
+    const size_t n = S.n;
+    if (A.size() != n) throw invalid_argument("size mismatch");
+    SquareMat C(n, 0.0);
+    const double* a = A.data();
+    double*       c = C.data();
+    parallel_for(0, n, kRowGrain, [&](size_t lo, size_t hi) {
+        for (size_t i = lo; i < hi; ++i) {
+            double* ci = c + i*n;
+            for (size_t k = 0; k < n; ++k) {
+                const double aik = a[i*n + k];
+                if (aik == 0.0) continue;
+                for (size_t p = S.rowp[k]; p < S.rowp[k + 1]; ++p) ci[S.cols[p]] += aik * S.vals[p];
+            }
+        }
+    });
+    return C;
+}
+
+SparseSquareMat SparseSquareMat::operator*(const SparseSquareMat& B) const {
+    if (n != B.n) throw invalid_argument("size mismatch");
+    // Gustavson: row i of C accumulates a(i,k) * row k of B; chunks of rows
+    // are built independently, then stitched together
+    struct Chunk { vector<size_t> cols, len; vector<double> vals; };
+    const size_t nchunks = (n + kRowGrain - 1) / kRowGrain;
+    vector<Chunk> parts(nchunks);
+    // iterate over chunk indices so each task knows which slot it fills,
+    // whatever ranges parallel_for hands out
+    parallel_for(0, nchunks, 1, [&](size_t c0, size_t c1) {
+        RowAccumulator acc(n);
+        for (size_t ch = c0; ch < c1; ++ch) {
+            Chunk& out = parts[ch];
+            const size_t lo = ch * kRowGrain, hi = std::min(n, lo + kRowGrain);
+            for (size_t i = lo; i < hi; ++i) {
+                size_t bound = 0;
+                for (size_t k = rowp[i]; k < rowp[i + 1]; ++k) bound += B.rowp[cols[k] + 1] - B.rowp[cols[k]];
+                acc.begin(std::min(bound, n));
+                for (size_t k = rowp[i]; k < rowp[i + 1]; ++k) {
+                    const double a = vals[k];
+                    const size_t r = cols[k];
+                    for (size_t p = B.rowp[r]; p < B.rowp[r + 1]; ++p) acc.add(B.cols[p], a * B.vals[p]);
+                }
+                out.len.push_back(acc.flush(out.cols, out.vals));
+            }
+        }
+    });
+
+    SparseSquareMat C(n);
+    size_t total = 0;
+    for (const Chunk& p : parts) total += p.cols.size();
+    C.cols.reserve(total);
+    C.vals.reserve(total);
+    size_t row = 0;
+    for (const Chunk& p : parts) {
+        C.cols.insert(C.cols.end(), p.cols.begin(), p.cols.end());
+        C.vals.insert(C.vals.end(), p.vals.begin(), p.vals.end());
+        for (size_t len : p.len) { C.rowp[row + 1] = C.rowp[row] + len; ++row; }
+    }
+    return C;
+}
+
+SparseSquareMat SparseSquareMat::operator^(unsigned int p) const {
+    if (p == 0) return identity(n);
+    SparseSquareMat base(*this), res(*this);
+    base.drop_csc(); res.drop_csc();
+    --p;
+    while (p) {
+        if (p & 1) res = res * base;
+        p >>= 1;
+        if (p) base = base * base;
+    }
+    return res;
+}
+
+} // namespace mat
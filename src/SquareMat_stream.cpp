@@ -0,0 +1,121 @@
+/*  Author: <Thelet.Shevach@gmail.com
+ *  SquareMat_stream.cpp : streaming matrix reader.
+ */
+
+#include "SquareMat_stream.h"
+#include "SquareMat_instr.h"
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <charconv>
+#include <cstring>
+#include <istream>
+#include <stdexcept>
+#include <unistd.h>
+
+using std::size_t;
+using std::invalid_argument;
+
+namespace {
+
+constexpr size_t kMinBuf = 64;    // also the longest token we accept
+
+inline bool is_ws(char c) { return std::isspace(static_cast<unsigned char>(c)); }
+
+} // namespace
+
+namespace mat {
+
+MatReader::MatReader(std::istream& s, size_t buf_size)
+ : kind(Src::Stream), in(&s),
+   buf(new char[buf_size < kMinBuf ? kMinBuf : buf_size]),
+   cap(buf_size < kMinBuf ? kMinBuf : buf_size) {}
+
+MatReader::MatReader(std::FILE* file, size_t buf_size)
+ : kind(Src::File), f(file),
+   buf(new char[buf_size < kMinBuf ? kMinBuf : buf_size]),
+   cap(buf_size < kMinBuf ? kMinBuf : buf_size) {}
+
+MatReader::MatReader(int d, size_t buf_size)
+ : kind(Src::Fd), fd(d),
+   buf(new char[buf_size < kMinBuf ? kMinBuf : buf_size]),
+   cap(buf_size < kMinBuf ? kMinBuf : buf_size) {}
+
+MatReader::~MatReader() { delete[] buf; }
+
+size_t MatReader::fill(char* dst, size_t want) {
+    switch (kind) {
+    case Src::Stream:
+        in->read(dst, static_cast<std::streamsize>(want));
+        return static_cast<size_t>(in->gcount());
+    case Src::File:
+        return std::fread(dst, 1, want, f);
+    case Src::Fd:
+        for (;;) {
+            ssize_t r = ::read(fd, dst, want);
+            if (r >= 0) return static_cast<size_t>(r);
+            if (errno != EINTR) throw std::runtime_error("read failed");
+        }
+    }
+    return 0;
+}
+
+// Next whitespace-delimited token as [b,e) inside buf; false at end of input.
+bool MatReader::token(const char*& b, const char*& e) {
+    for (;;) {
+        while (pos < len && is_ws(buf[pos])) ++pos;
+        if (pos < len) break;
+        if (eof) return false;
+        pos = 0;
+        len = fill(buf, cap);
+        if (len == 0) { eof = true; return false; }
+    }
+    size_t end = pos;
+    for (;;) {
+        while (end < len && !is_ws(buf[end])) ++end;
+        if (end < len || eof) break;
+        // token straddles the buffer edge: slide it to the front and refill
+        size_t keep = len - pos;
+        if (keep == cap) throw invalid_argument("token too long");
+        std::memmove(buf, buf + pos, keep);
+        end -= pos; pos = 0; len = keep;
+        size_t got = fill(buf + len, cap - len);
+        if (got == 0) eof = true;
+        len += got;
+    }
+    b = buf + pos;
+    e = buf + end;
+    pos = end;
+    return true;
+}
+
+bool MatReader::next(SquareMat& m) {
+    SQUAREMAT_TRACE_SPAN("read", 0);
+    const char *b, *e;
+    if (!token(b, e)) return false;
+
+    unsigned long long dim = 0;
+    auto rd = std::from_chars(b, e, dim);
+    if (rd.ec != std::errc() || rd.ptr != e || dim == 0 || dim > 0xFFFFFFFFull)
+        throw invalid_argument("failed to read dimension");
+
+    // Values go to vals first so a bad or truncated matrix leaves m intact;
+    // vals grows as data arrives, never up front from an untrusted dim.
+    const size_t count = static_cast<size_t>(dim) * static_cast<size_t>(dim);
+    vals.clear();
+    for (size_t i = 0; i < count; ++i) {
+        if (!token(b, e)) throw invalid_argument("failed to read data");
+        if (*b == '+' && e - b > 1 && (std::isdigit(static_cast<unsigned char>(b[1])) || b[1] == '.'))
+            ++b;
+        double v;
+        auto r = std::from_chars(b, e, v);
+        if (r.ec != std::errc() || r.ptr != e) throw invalid_argument("failed to read data");
+        vals.push_back(v);
+    }
+    m.reshape(static_cast<size_t>(dim));
+    std::copy(vals.begin(), vals.end(), m.buf);
+    ++matrices;
+    return true;
+}
+
+} // namespace mat
@@ -0,0 +1,66 @@
+/*  Author: <Thelet.Shevach@gmail.com
+ *  SquareMat_struct.cpp : structure detection and banded determinant.
+ */
+
+#include "SquareMat.h"
+#include "SquareMat_instr.h"
+#include "SquareMat_alloc.h"
+#include <cmath>
+#include <utility>
+
+using std::size_t;
+
+namespace mat {
+
+Structure SquareMat::structure() const {
+    size_t kl = 0, ku = 0;
+    for (size_t i = 0; i < n; ++i) {
+        const double* row = buf + i*n;
+        // leftmost non-zero left of the diagonal, rightmost right of it;
+        // only columns beyond the bandwidths found so far need scanning
+        for (size_t j = 0; j + kl < i; ++j)
+            if (row[j] != 0.0) { kl = i - j; break; }
+        for (size_t j = n - 1; j > i + ku; --j)
+            if (row[j] != 0.0) { ku = j - i; break; }
+        if (kl && ku && kl + ku >= n/2) return {Structure::General, n - 1, n - 1};  // bands not refined
+    }
+    Structure::Kind kind = Structure::General;
+    if (kl == 0 && ku == 0)  kind = Structure::Diagonal;
+    else if (kl == 0)        kind = Structure::Upper;
+    else if (ku == 0)        kind = Structure::Lower;
+    else if (kl + ku < n/2)  kind = Structure::Banded;
+    return {kind, kl, ku};
+}
+
+double SquareMat::determinant_band(size_t kl, size_t ku) const {
+    SQUAREMAT_SCOPE("lu_band", n);
+    // partial pivoting within the band; row swaps widen the upper band to kl+ku
+    const size_t w = kl + ku;
+    mem::Scratch scratch(n*n, "lu_scratch");
+    double* tmp = scratch.get();
+    for (size_t i = 0; i < n*n; ++i) tmp[i] = buf[i];
+
+    double det = 1.0;
+    for (size_t k = 0; k < n; ++k) {
+        const size_t last = k + kl < n - 1 ? k + kl : n - 1;       // last row with a(i,k) != 0
+        const size_t jend = k + w  < n - 1 ? k + w  : n - 1;       // last touched column
+        size_t piv = k;
+        for (size_t i = k+1; i <= last; ++i)
+            if (std::fabs(tmp[i*n + k]) > std::fabs(tmp[piv*n + k])) piv = i;
+        if (std::fabs(tmp[piv*n + k]) < 1e-12) { det = 0; break; }
+        if (piv != k) {
+            for (size_t j = k; j <= jend; ++j) std::swap(tmp[k*n + j], tmp[piv*n + j]);
+            det = -det;
+        }
+        const double pivot = tmp[k*n + k];
+        det *= pivot;
+        for (size_t i = k+1; i <= last; ++i) {
+            const double f = tmp[i*n + k] / pivot;
+            if (f == 0.0) continue;
+            for (size_t j = k; j <= jend; ++j) tmp[i*n + j] -= f * tmp[k*n + j];
+        }
+    }
+    return det;
+}
+
+} // namespace mat
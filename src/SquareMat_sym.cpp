@@ -0,0 +1,163 @@
+/*  Author: <Thelet.Shevach@gmail.com
+ *  SquareMat_sym.cpp : packed symmetric matrix.
+ */
+
+#include "SquareMat_sym.h"
+#include "SquareMat_alloc.h"
+#include <cmath>
+#include <stdexcept>
+
+using std::size_t;
+using std::invalid_argument;
+
+namespace mat {
+
+SymmetricMat::SymmetricMat(size_t dim, double val)
+ : n(dim), buf(nullptr)
+{
+    if (n == 0) throw invalid_argument("size must be >0");
+    buf = mem::alloc(packed(), "ctor");
+    for (size_t i = 0; i < packed(); ++i) buf[i] = val;
+}
+
+SymmetricMat::SymmetricMat(const SquareMat& m, double tol)
+ : n(m.size()), buf(nullptr)
+{
+    if (!is_symmetric(m, tol)) throw invalid_argument("matrix is not symmetric");
+    buf = mem::alloc(packed(), "ctor");
+    double* out = buf;
+    for (size_t i = 0; i < n; ++i) {
+        const double* row = m.row_ptr(i);
+        for (size_t j = i; j < n; ++j) *out++ = row[j];
+    }
+}
+
+SymmetricMat::SymmetricMat(const SymmetricMat& o)
+ : n(o.n), buf(mem::alloc(o.packed(), "copy"))
+{
+    for (size_t i = 0; i < packed(); ++i) buf[i] = o.buf[i];
+}
+
+SymmetricMat& SymmetricMat::operator=(const SymmetricMat& o) {
+    if (this != &o) {
+        double* fresh = mem::alloc(o.packed(), "copy");
+        for (size_t i = 0; i < o.packed(); ++i) fresh[i] = o.buf[i];
+        mem::free(buf);
+        buf = fresh;
+        n = o.n;
+    }
+    return *this;
+}
+
+SymmetricMat::~SymmetricMat() {
+    mem::free(buf);
+}
+
+bool SymmetricMat::is_symmetric(const SquareMat& m, double tol) {
+    const size_t n = m.size();
+    const double* a = m.data();
+    for (size_t i = 0; i < n; ++i)
+        for (size_t j = i+1; j < n; ++j)
+            if (std::fabs(a[i*n + j] - a[j*n + i]) > tol) return false;
+    return true;
+}
+
+SymmetricMat SymmetricMat::syrk(const SquareMat& A) {
+    const size_t n = A.size();
+    SymmetricMat S(n);
+    const double* a = A.data();
+    double* out = S.buf;
+    // c(i,j) = <row i, row j>: both operands are contiguous rows of A
+    for (size_t i = 0; i < n; ++i) {
+        const double* ri = a + i*n;
+        for (size_t j = i; j < n; ++j) {
+            const double* rj = a + j*n;
+            double s = 0.0;
+            for (size_t k = 0; k < n; ++k) s += ri[k] * rj[k];
+            *out++ = s;
+        }
+    }
+    return S;
+}
+
+SquareMat SymmetricMat::to_square() const {
+    SquareMat M(n);
+    double* m = M.data();
+    const double* p = buf;
+    for (size_t i = 0; i < n; ++i)
+        for (size_t j = i; j < n; ++j, ++p) m[i*n + j] = m[j*n + i] = *p;
+    return M;
+}
+
+SymmetricMat SymmetricMat::operator+(const SymmetricMat& o) const {
+    if (n != o.n) throw invalid_argument("size mismatch");
+    SymmetricMat r(n);
+    for (size_t i = 0; i < packed(); ++i) r.buf[i] = buf[i] + o.buf[i];
+    return r;
+}
+
+SymmetricMat SymmetricMat::operator-(const SymmetricMat& o) const {
+    if (n != o.n) throw invalid_argument("size mismatch");
+    SymmetricMat r(n);
+    for (size_t i = 0; i < packed(); ++i) r.buf[i] = buf[i] - o.buf[i];
+    return r;
+}
+
+SymmetricMat SymmetricMat::operator*(double s) const {
+    SymmetricMat r(n);
+    for (size_t i = 0; i < packed(); ++i) r.buf[i] = buf[i] * s;
+    return r;
+}
+
+SquareMat SymmetricMat::operator*(const SquareMat& B) const {
+    if (n != B.size()) throw invalid_argument("size mismatch");
+    SquareMat C(n, 0.0);
+    const double* b = B.data();
+    double*       c = C.data();
+    // each stored s(i,k), i<=k, feeds row i (with row k of B) and, off the
+    // diagonal, row k (with row i of B): the packed triangle is read once
+    for (size_t i = 0; i < n; ++i) {
+        const double* srow = buf + idx(i, i);
+        double*       ci   = c + i*n;
+        const double* bi   = b + i*n;
+        for (size_t k = i; k < n; ++k) {
+            const double s  = srow[k - i];
+            const double* bk = b + k*n;
+            for (size_t j = 0; j < n; ++j) ci[j] += s * bk[j];
+            if (k != i) {
+                double* ck = c + k*n;
+                for (size_t j = 0; j < n; ++j) ck[j] += s * bi[j];
+            }
+        }
+    }
+    return C;
+}
+
+SquareMat SymmetricMat::operator*(const SymmetricMat& T) const {
+    if (n != T.n) throw invalid_argument("size mismatch");
+    return (*this) * T.to_square();
+}
+
+double SymmetricMat::operator!() const {
+    // right-looking packed Cholesky U^T U on a scratch copy
+    mem::Scratch scratch(packed(), "chol_scratch");
+    double* u = scratch.get();
+    for (size_t i = 0; i < packed(); ++i) u[i] = buf[i];
+    double det = 1.0;
+    bool spd = true;
+    for (size_t k = 0; k < n && spd; ++k) {
+        double* rk = u + idx(k, k);
+        if (!(rk[0] > 0.0)) { spd = false; break; }
+        const double d = std::sqrt(rk[0]);
+        det *= rk[0];                      // (u_kk)^2
+        for (size_t j = 1; j < n - k; ++j) rk[j] /= d;
+        for (size_t i = k+1; i < n; ++i) {
+            const double f = rk[i - k];
+            double* ri = u + idx(i, i);
+            for (size_t j = i; j < n; ++j) ri[j - i] -= f * rk[j - k];
+        }
+    }
+    return spd ? det : !to_square();
+}
+
+} // namespace mat
@@ -0,0 +1,178 @@
+/*  Author: <Thelet.Shevach@gmail.com
+ *  SquareMat_trace.cpp : per-thread span rings and Chrome trace export.
+ */
+
+#include "SquareMat_trace.h"
+#include "SquareMat_instr.h"
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <vector>
+
+using std::size_t;
+using std::uint64_t;
+
+namespace mat {
+namespace trace {
+
+namespace detail { std::atomic<bool> on{false}; }
+
+namespace {
+
+constexpr size_t kRing = size_t(1) << 15;   // events kept per thread
+
+/** Single-producer ring: only the owning thread writes, with relaxed stores
+ *  and a release on `head`; the exporter may read concurrently and drops
+ *  any slot the writer could have lapped meanwhile (a seqlock on `head`:
+ *  the writer fences before touching a slot, the reader after reading it). */
+struct Ring {
+    struct Slot {
+        std::atomic<const char*> name{nullptr};
+        std::atomic<uint64_t>    n{0}, start{0}, end{0};
+    };
+    std::unique_ptr<Slot[]> slots{new Slot[kRing]};
+    std::atomic<uint64_t>   head{0};
+    std::atomic<uint64_t>   floor{0};            // clear() moves this up
+    size_t                  tid;
+
+    explicit Ring(size_t id) : tid(id) {}
+};
+
+std::mutex                          registry_mtx;
+std::vector<std::shared_ptr<Ring>>  rings;      // outlive their threads
+std::vector<std::shared_ptr<Ring>>  idle;       // rings of exited threads, reused first
+const uint64_t                      epoch = [] {
+    return uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+}();
+
+/// A thread's ring, handed back at thread exit: its events stay exportable
+/// until a later thread takes it over (same tid), so memory is bounded by
+/// the most threads ever tracing at once rather than by thread churn.
+struct Lease {
+    std::shared_ptr<Ring> ring;
+    Lease() {
+        std::lock_guard<std::mutex> lock(registry_mtx);
+        if (!idle.empty()) {
+            ring = std::move(idle.back());
+            idle.pop_back();
+        } else {
+            rings.push_back(std::make_shared<Ring>(rings.size() + 1));
+            ring = rings.back();
+        }
+    }
+    ~Lease() {
+        std::lock_guard<std::mutex> lock(registry_mtx);
+        idle.push_back(std::move(ring));
+    }
+    Lease(const Lease&)            = delete;
+    Lease& operator=(const Lease&) = delete;
+};
+
+Ring& local_ring() {
+    thread_local Lease lease;
+    return *lease.ring;
+}
+
+std::string target;
+
+// SQUAREMAT_TRACE=<file> records from load time and writes the trace at exit
+const bool from_env = [] {
+    const char* v = std::getenv("SQUAREMAT_TRACE");
+    if (!compiled() || !v || !*v || std::strcmp(v, "0") == 0) return false;
+    target = v;
+    detail::on.store(true, std::memory_order_relaxed);
+    std::atexit([] { write_json(target); });
+    return true;
+}();
+
+} // namespace
+
+namespace detail {
+
+uint64_t now_ns() {
+    return uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+void record(const char* name, size_t n, uint64_t start_ns, uint64_t end_ns) {
+    Ring& r = local_ring();
+    const uint64_t h = r.head.load(std::memory_order_relaxed);
+    Ring::Slot& s = r.slots[h % kRing];
+    // order the previous head store before these slot stores for readers
+    std::atomic_thread_fence(std::memory_order_release);
+    s.name.store(name, std::memory_order_relaxed);
+    s.n.store(n, std::memory_order_relaxed);
+    s.start.store(start_ns, std::memory_order_relaxed);
+    s.end.store(end_ns, std::memory_order_relaxed);
+    r.head.store(h + 1, std::memory_order_release);
+}
+
+} // namespace detail
+
+bool compiled() {
+#ifdef SQUAREMAT_TRACE
+    return true;
+#else
+    return false;
+#endif
+}
+
+void enable(bool on) { detail::on.store(on && compiled(), std::memory_order_relaxed); }
+bool enabled()       { return detail::on.load(std::memory_order_relaxed); }
+
+void clear() {
+    std::lock_guard<std::mutex> lock(registry_mtx);
+    for (auto& r : rings) r->floor.store(r->head.load(std::memory_order_acquire), std::memory_order_relaxed);
+}
+
+void write_json(std::ostream& out) {
+    std::vector<std::shared_ptr<Ring>> snap;
+    {
+        std::lock_guard<std::mutex> lock(registry_mtx);
+        snap = rings;
+    }
+    const std::ios::fmtflags flags = out.flags();
+    out << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[" << std::fixed << std::setprecision(3);
+    bool first = true;
+    auto us = [](uint64_t ns) { return double(ns - epoch) / 1e3; };
+    for (const auto& r : snap) {
+        out << (first ? "" : ",") << "\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << r->tid
+            << ",\"args\":{\"name\":\"squaremat-" << r->tid << "\"}}";
+        first = false;
+        const uint64_t head = r->head.load(std::memory_order_acquire);
+        uint64_t lo = head > kRing ? head - kRing : 0;
+        lo = lo > r->floor.load(std::memory_order_relaxed) ? lo : r->floor.load(std::memory_order_relaxed);
+        for (uint64_t i = lo; i < head; ++i) {
+            const Ring::Slot& s = r->slots[i % kRing];
+            const char*    name  = s.name.load(std::memory_order_relaxed);
+            const uint64_t n     = s.n.load(std::memory_order_relaxed);
+            const uint64_t start = s.start.load(std::memory_order_relaxed);
+            const uint64_t end   = s.end.load(std::memory_order_relaxed);
+            // the writer may have lapped this slot while we read it
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (r->head.load(std::memory_order_relaxed) >= i + kRing) continue;
+            if (!name || start < epoch || end < start) continue;
+            out << ",\n{\"name\":\"" << name << "\",\"cat\":\"squaremat\",\"ph\":\"X\",\"pid\":1,\"tid\":" << r->tid
+                << ",\"ts\":" << us(start) << ",\"dur\":" << double(end - start) / 1e3
+                << ",\"args\":{\"n\":" << n << "}}";
+        }
+    }
+    out << "\n]}\n";
+    out.flags(flags);
+}
+
+bool write_json(const std::string& path) {
+    std::ofstream f(path);
+    if (!f) return false;
+    write_json(f);
+    return bool(f);
+}
+
+} // namespace trace
+} // namespace mat
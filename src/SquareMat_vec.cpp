@@ -0,0 +1,221 @@
+/*  Author: <Thelet.Shevach@gmail.com
+ *  SquareMat_vec.cpp : Vec, GEMV kernels, batched products, power iteration.
+ */
+
+#include "SquareMat_vec.h"
+#include "SquareMat_pool.h"
+#include "SquareMat_instr.h"
+#include "SquareMat_alloc.h"
+#include <charconv>
+#include <cctype>
+#include <cmath>
+#include <stdexcept>
+
+using std::size_t;
+using std::invalid_argument;
+
+namespace {
+
+constexpr size_t kRowGrain = 64;
+constexpr size_t kParMin   = 256;   // below this, threads cost more than they save
+
+// four independent accumulators let the compiler vectorize the reduction
+inline double dot4(const double* a, const double* b, size_t n) {
+    double s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+    size_t j = 0;
+    for (; j + 4 <= n; j += 4) {
+        s0 += a[j]   * b[j];
+        s1 += a[j+1] * b[j+1];
+        s2 += a[j+2] * b[j+2];
+        s3 += a[j+3] * b[j+3];
+    }
+    for (; j < n; ++j) s0 += a[j] * b[j];
+    return (s0 + s1) + (s2 + s3);
+}
+
+inline void axpy(double a, const double* x, double* y, size_t n) {
+    for (size_t j = 0; j < n; ++j) y[j] += a * x[j];
+}
+
+void rows_parallel(size_t n, const std::function<void(size_t, size_t)>& body) {
+    if (n < kParMin) body(0, n);
+    else mat::parallel_for(0, n, kRowGrain, body);
+}
+
+} // namespace
+
+namespace mat {
+
+//─── Vec ────────────────────────────────────────────────────
+
+Vec::Vec(size_t len, double val) : n(len), buf(nullptr) {
+    if (n == 0) throw invalid_argument("size must be >0");
+    buf = mem::alloc(n, "ctor");
+    for (size_t i = 0; i < n; ++i) buf[i] = val;
+}
+
+Vec::Vec(size_t len, const double* raw) : n(len), buf(nullptr) {
+    if (n == 0) throw invalid_argument("size must be >0");
+    buf = mem::alloc(n, "ctor");
+    for (size_t i = 0; i < n; ++i) buf[i] = raw[i];
+}
+
+Vec::Vec(const Vec& o) : n(o.n), buf(mem::alloc(o.n, "copy")) {
+    for (size_t i = 0; i < n; ++i) buf[i] = o.buf[i];
+}
+
+Vec& Vec::operator=(const Vec& o) {
+    if (this != &o) {
+        double* fresh = mem::alloc(o.n, "copy");
+        for (size_t i = 0; i < o.n; ++i) fresh[i] = o.buf[i];
+        mem::free(buf);
+        buf = fresh;
+        n = o.n;
+    }
+    return *this;
+}
+
+Vec::~Vec() { mem::free(buf); }
+
+Vec Vec::from_string(const std::string& spec) {
+    std::vector<double> vals;
+    const char* p = spec.data();
+    const char* e = p + spec.size();
+    while (p != e) {
+        if (std::isspace(static_cast<unsigned char>(*p)) || *p == ',') { ++p; continue; }
+        if (*p == '+') ++p;
+        double v;
+        auto r = std::from_chars(p, e, v);
+        if (r.ec != std::errc())
+            throw invalid_argument("invalid number at position " + std::to_string(p - spec.data()));
+        vals.push_back(v);
+        p = r.ptr;
+    }
+    if (vals.empty()) throw invalid_argument("empty spec");
+    return Vec(vals.size(), vals.data());
+}
+
+Vec Vec::operator+(const Vec& o) const {
+    if (n != o.n) throw invalid_argument("size mismatch");
+    Vec r(n);
+    for (size_t i = 0; i < n; ++i) r.buf[i] = buf[i] + o.buf[i];
+    return r;
+}
+
+Vec Vec::operator-(const Vec& o) const {
+    if (n != o.n) throw invalid_argument("size mismatch");
+    Vec r(n);
+    for (size_t i = 0; i < n; ++i) r.buf[i] = buf[i] - o.buf[i];
+    return r;
+}
+
+Vec Vec::operator*(double s) const {
+    Vec r(n);
+    for (size_t i = 0; i < n; ++i) r.buf[i] = buf[i] * s;
+    return r;
+}
+
+double Vec::dot(const Vec& o) const {
+    if (n != o.n) throw invalid_argument("size mismatch");
+    return dot4(buf, o.buf, n);
+}
+
+double Vec::norm() const { return std::sqrt(dot4(buf, buf, n)); }
+
+std::ostream& operator<<(std::ostream& out, const Vec& v) {
+    for (size_t i = 0; i < v.n; ++i) out << v.buf[i] << (i+1 < v.n ? ' ' : '\n');
+    return out;
+}
+
+//─── GEMV ───────────────────────────────────────────────────
+
+void gemv(double alpha, const SquareMat& A, const Vec& x, double beta, Vec& y, Trans t) {
+    SQUAREMAT_SCOPE("gemv", A.size());
+    const size_t n = A.size();
+    if (x.size() != n || y.size() != n) throw invalid_argument("size mismatch");
+    if (&x == &y) throw invalid_argument("x and y must not alias");
+    const double* a  = A.data();
+    const double* xv = x.data();
+    double*       yv = y.data();
+
+    if (t == Trans::No) {
+        rows_parallel(n, [&](size_t lo, size_t hi) {
+            for (size_t i = lo; i < hi; ++i)
+                yv[i] = alpha * dot4(a + i*n, xv, n) + (beta == 0.0 ? 0.0 : beta * yv[i]);
+        });
+        return;
+    }
+    // Aᵀx = Σ x_i · row_i: each chunk owns a column range of y
+    rows_parallel(n, [&](size_t lo, size_t hi) {
+        double* yl = yv + lo;
+        for (size_t j = 0; j < hi - lo; ++j) yl[j] = beta == 0.0 ? 0.0 : beta * yl[j];
+        for (size_t i = 0; i < n; ++i) axpy(alpha * xv[i], a + i*n + lo, yl, hi - lo);
+    });
+}
+
+Vec operator*(const SquareMat& A, const Vec& x) {
+    Vec y(A.size());
+    gemv(1.0, A, x, 0.0, y);
+    return y;
+}
+
+Vec operator*(const Vec& x, const SquareMat& A) {
+    Vec y(A.size());
+    gemv(1.0, A, x, 0.0, y, Trans::Yes);
+    return y;
+}
+
+Vec operator*(TransposedRef At, const Vec& x) { return x * At.m; }
+
+std::vector<Vec> multiply(const SquareMat& A, const std::vector<Vec>& xs) {
+    const size_t n = A.size();
+    for (const Vec& x : xs) if (x.size() != n) throw invalid_argument("size mismatch");
+    std::vector<Vec> ys(xs.size(), Vec(n));
+    const double* a = A.data();
+    rows_parallel(n, [&](size_t lo, size_t hi) {
+        size_t v = 0;
+        for (; v + 4 <= xs.size(); v += 4) {
+            const double *x0 = xs[v].data(), *x1 = xs[v+1].data(), *x2 = xs[v+2].data(), *x3 = xs[v+3].data();
+            for (size_t i = lo; i < hi; ++i) {
+                const double* r = a + i*n;
+                double s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+                for (size_t j = 0; j < n; ++j) {
+                    const double aij = r[j];
+                    s0 += aij * x0[j]; s1 += aij * x1[j]; s2 += aij * x2[j]; s3 += aij * x3[j];
+                }
+                ys[v].data()[i] = s0; ys[v+1].data()[i] = s1; ys[v+2].data()[i] = s2; ys[v+3].data()[i] = s3;
+            }
+        }
+        for (; v < xs.size(); ++v)
+            for (size_t i = lo; i < hi; ++i) ys[v].data()[i] = dot4(a + i*n, xs[v].data(), n);
+    });
+    return ys;
+}
+
+//─── Power iteration ────────────────────────────────────────
+
+EigenPair power_iteration(const SquareMat& A, size_t max_iter, double tol) {
+    const size_t n = A.size();
+    Vec v(n, 1.0 / std::sqrt(double(n))), w(n);
+    EigenPair res{0.0, v, 0, false};
+    for (size_t it = 1; it <= max_iter; ++it) {
+        gemv(1.0, A, v, 0.0, w);
+        const double nw = w.norm();
+        if (nw == 0.0) { res.value = 0.0; res.vector = v; res.iterations = it; res.converged = true; return res; }
+        const double lambda = v.dot(w);               // Rayleigh quotient (|v| = 1)
+        w = w * (1.0 / nw);
+        double diff = 0.0, diff_neg = 0.0;             // compare up to sign flips
+        for (size_t i = 0; i < n; ++i) {
+            diff     += (w[i] - v[i]) * (w[i] - v[i]);
+            diff_neg += (w[i] + v[i]) * (w[i] + v[i]);
+        }
+        v = w;
+        res.value = lambda;
+        res.iterations = it;
+        if (std::sqrt(diff < diff_neg ? diff : diff_neg) < tol) { res.converged = true; break; }
+    }
+    res.vector = v;
+    return res;
+}
+
+} // namespace mat
@@ -1,11 +1,73 @@
 #define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
 #include "doctest.h"
 #include "SquareMat.h"
+#include "SquareMat_stream.h"
+#include "SquareMat_formats.h"
+#include "SquareMat_compress.h"
+#include "SquareMat_pool.h"
+#include "SquareMat_sym.h"
+#include "SquareMat_chol.h"
+#include "SquareMat_sparse.h"
+#include "SquareMat_vec.h"
+#include "SquareMat_perf.h"
+#include "SquareMat_mem.h"
+#include "SquareMat_trace.h"
+#include "SquareMat_async.h"
+#include "SquareMat_pipeline.h"
+#include "SquareMat_graph.h"
+#include "SquareMat_numa.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iterator>
+#include <numeric>
+#include <vector>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <future>
+#include <sstream>
 #include <stdexcept>
+#include <thread>
+#ifdef __linux__
+#include <linux/mempolicy.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
 
 using mat::SquareMat;
 using std::invalid_argument;
 
+namespace {
+
+// Unique file under the system temp directory, removed on scope exit.
+struct TempFile {
+    std::string path;
+    explicit TempFile(const std::string& suffix) {
+        std::string tmpl = (std::filesystem::temp_directory_path() / "squaremat_XXXXXX").string() + suffix;
+        int fd = ::mkstemps(&tmpl[0], static_cast<int>(suffix.size()));
+        if (fd < 0) throw std::runtime_error("mkstemps failed");
+        ::close(fd);
+        path = tmpl;
+    }
+    ~TempFile() { std::remove(path.c_str()); }
+    TempFile(const TempFile&) = delete;
+    TempFile& operator=(const TempFile&) = delete;
+};
+
+// Element-wise equality within a relative tolerance; operator== only compares sums.
+bool same_elems(const SquareMat& X, const SquareMat& Y, double tol = 0.0) {
+    if (X.size() != Y.size()) return false;
+    for (std::size_t i = 0; i < X.size(); ++i)
+        for (std::size_t j = 0; j < X.size(); ++j)
+            if (std::fabs(X[i][j] - Y[i][j]) > tol * (1 + std::fabs(Y[i][j]))) return false;
+    return true;
+}
+
+} // namespace
+
 // 1. Addition and subtraction (valid, mismatch)
 TEST_CASE("Matrix addition and subtraction - valid") {
     SquareMat A = SquareMat::from_string("1 2 3,4 5 6,7 8 9");
@@ -138,3 +200,1136 @@ TEST_CASE("Constructor and from_string errors") {
     CHECK_THROWS_AS(SquareMat(0), invalid_argument);
     CHECK_THROWS_AS(SquareMat::from_string("1 2 3"), invalid_argument);
 }
+
+// 13. from_string parsing details
+TEST_CASE("from_string row validation and formats") {
+    CHECK(SquareMat::from_string("1 2 3 4") == SquareMat::from_string("1 2,3 4"));
+    CHECK(SquareMat::from_string(" +1.5 -2e1 ,\t3 4, ")[1][0] == doctest::Approx(3));
+    CHECK(SquareMat::from_string("1 2,3 4")[0][1] == doctest::Approx(2));
+    CHECK_THROWS_AS(SquareMat::from_string(""), invalid_argument);
+    CHECK_THROWS_AS(SquareMat::from_string("1 2,3"), invalid_argument);
+    CHECK_THROWS_AS(SquareMat::from_string("1 2,3 4 5"), invalid_argument);
+    CHECK_THROWS_AS(SquareMat::from_string("1 2,3 4,5 6"), invalid_argument);
+    CHECK_THROWS_AS(SquareMat::from_string("1 2"), invalid_argument);
+    CHECK_THROWS_AS(SquareMat::from_string("1 x,3 4"), invalid_argument);
+    CHECK_THROWS_AS(SquareMat::from_string("1 +-3,3 4"), invalid_argument);
+    CHECK_THROWS_AS(SquareMat::from_string("1 +,3 4"), invalid_argument);
+    CHECK(SquareMat::from_string("+.5 1,3 4")[0][0] == doctest::Approx(0.5));
+    try {
+        SquareMat::from_string("1 2,3 x");
+        FAIL("expected throw");
+    } catch (const invalid_argument& e) {
+        CHECK(std::string(e.what()).find("position 6") != std::string::npos);
+    }
+}
+
+// 14. Text output
+TEST_CASE("operator<< and write_text round-trip") {
+    SquareMat M = SquareMat::from_string("1 -2.5,0.1 1e300");
+    std::ostringstream os;
+    os << M;
+    CHECK(os.str() == "1 -2.5\n0.1 1e+300\n");
+
+    std::FILE* f = std::tmpfile();
+    REQUIRE(f != nullptr);
+    M.write_text(f);
+    std::rewind(f);
+    char buf[64] = {};
+    std::size_t got = std::fread(buf, 1, sizeof(buf) - 1, f);
+    std::fclose(f);
+    CHECK(std::string(buf, got) == os.str());
+}
+
+// 15. Streaming reader over concatenated matrices
+TEST_CASE("MatReader reads back-to-back matrices") {
+    std::istringstream in("2 1 2 3 4\n2 5 6\n7 8   3 1 0 0 0 1 0 0 0 +1\n");
+    mat::MatReader rd(in, 16);
+    SquareMat M(2);
+    REQUIRE(rd.next(M));
+    CHECK(M == SquareMat::from_string("1 2,3 4"));
+    REQUIRE(rd.next(M));
+    CHECK(M[1][1] == doctest::Approx(8));
+    REQUIRE(rd.next(M));
+    CHECK(M.size() == 3);
+    CHECK(!M == doctest::Approx(1));
+    CHECK_FALSE(rd.next(M));
+    CHECK(rd.count() == 3);
+
+    std::istringstream in2("1 7 1 8 1 9");
+    mat::MatReader rd2(in2);
+    double s = 0;
+    for (const SquareMat& m : rd2) s += m[0][0];
+    CHECK(s == doctest::Approx(24));
+
+    // many matrices through the minimum buffer: tokens straddle every refill
+    std::ostringstream many;
+    for (int k = 0; k < 50; ++k) many << "2 " << k << ".125 -1e-3 0 " << k << '\n';
+    std::istringstream in3(many.str());
+    mat::MatReader rd4(in3, 1);
+    double diag = 0;
+    while (rd4.next(M)) diag += M[1][1];
+    CHECK(rd4.count() == 50);
+    CHECK(diag == doctest::Approx(1225));
+
+    // a failed read leaves the target untouched
+    M = SquareMat::from_string("1 2,3 4");
+    std::istringstream bad("2 1 2 3");
+    mat::MatReader rd3(bad);
+    CHECK_THROWS_AS(rd3.next(M), invalid_argument);
+    CHECK(M.size() == 2);
+    CHECK((M[0][0] == 1 && M[0][1] == 2 && M[1][0] == 3 && M[1][1] == 4));
+
+    std::istringstream bad2("3 1 2 3 4 5 6 7 8 x");
+    mat::MatReader rd5(bad2);
+    CHECK_THROWS_AS(rd5.next(M), invalid_argument);
+    CHECK(M.size() == 2);
+    CHECK(M[1][1] == 4);
+
+    std::istringstream sign("1 +-1");
+    mat::MatReader rd6(sign);
+    CHECK_THROWS_AS(rd6.next(M), invalid_argument);
+    CHECK(M[0][0] == 1);
+}
+
+// 16. .npy and MatrixMarket round-trips
+TEST_CASE("npy and MatrixMarket import/export") {
+    SquareMat M = SquareMat::from_string("1 2 0,0 -4.5 6,7 0 9");
+    TempFile npy_file(".npy"), mtx_file(".mtx");
+    const std::string& npy = npy_file.path;
+    const std::string& mtx = mtx_file.path;
+
+    mat::save_npy(M, npy);
+    SquareMat A = mat::load_npy(npy);
+    CHECK(A[1][1] == doctest::Approx(-4.5));
+    CHECK(A[2][0] == doctest::Approx(7));
+
+    mat::save_npy(M, npy, mat::NpyType::Float32, mat::NpyOrder::Fortran);
+    SquareMat B = mat::load_npy(npy);
+    CHECK(B[0][1] == doctest::Approx(2));
+    CHECK(B[1][2] == doctest::Approx(6));
+    CHECK((B - M).total() == doctest::Approx(0));
+
+    mat::save_mm(M, mtx);
+    SquareMat C = mat::load_mm(mtx);
+    CHECK(C[2][0] == doctest::Approx(7));
+    CHECK(C[0][2] == doctest::Approx(0));
+
+    mat::save_mm(M, mtx, mat::MMFormat::Coordinate);
+    SquareMat D = mat::load_mm(mtx);
+    CHECK(D[1][2] == doctest::Approx(6));
+    CHECK(D.total() == doctest::Approx(M.total()));
+
+    std::FILE* f = std::fopen(mtx.c_str(), "w");
+    REQUIRE(f != nullptr);
+    std::fputs("%%MatrixMarket matrix coordinate real symmetric\n% comment\n2 2 2\n1 1 3\n2 1 5\n", f);
+    std::fclose(f);
+    SquareMat S = mat::load_mm(mtx);
+    CHECK(S[0][1] == doctest::Approx(5));
+    CHECK(S[1][0] == doctest::Approx(5));
+
+    // a shape whose byte count wraps size_t, and one larger than the payload
+    auto write_npy = [&](const std::string& shape, std::size_t payload) {
+        std::string dict = "{'descr': '<f8', 'fortran_order': True, 'shape': " + shape + ", }";
+        dict.append((64 - (10 + dict.size() + 1) % 64) % 64, ' ');
+        dict.push_back('\n');
+        std::FILE* out = std::fopen(npy.c_str(), "wb");
+        REQUIRE(out != nullptr);
+        const unsigned char pre[10] = {0x93, 'N', 'U', 'M', 'P', 'Y', 1, 0,
+                                       static_cast<unsigned char>(dict.size()), 0};
+        std::fwrite(pre, 1, sizeof pre, out);
+        std::fwrite(dict.data(), 1, dict.size(), out);
+        std::vector<double> zeros(payload, 0.0);
+        std::fwrite(zeros.data(), sizeof(double), zeros.size(), out);
+        std::fclose(out);
+    };
+    write_npy("(4294967296, 4294967296)", 4);
+    CHECK_THROWS_AS(mat::load_npy(npy), invalid_argument);
+    write_npy("(1073741824, 1073741824)", 4);
+    CHECK_THROWS_AS(mat::load_npy(npy), invalid_argument);
+    write_npy("(3, 3)", 8);
+    CHECK_THROWS_AS(mat::load_npy(npy), invalid_argument);
+    write_npy("(3, 3)", 9);
+    CHECK(mat::load_npy(npy).size() == 3);
+
+    std::remove(npy.c_str());
+    std::remove(mtx.c_str());
+    CHECK_THROWS_AS(mat::load_npy(mtx), std::runtime_error);
+}
+
+// 17. Thread pool
+TEST_CASE("ThreadPool parallel_for covers the range once") {
+    mat::ThreadPool pool(3);
+    std::vector<int> hits(1000, 0);
+    pool.parallel_for(0, hits.size(), 7, [&](std::size_t lo, std::size_t hi) {
+        for (std::size_t i = lo; i < hi; ++i) ++hits[i];
+    });
+    int total = 0;
+    for (int h : hits) total += h;
+    CHECK(total == 1000);
+    CHECK_THROWS_AS(pool.parallel_for(0, 10, 1, [](std::size_t lo, std::size_t) {
+        if (lo == 5) throw invalid_argument("boom");
+    }), invalid_argument);
+}
+
+// 18. Compressed container
+TEST_CASE("LZ codec and .sqmz container") {
+    std::vector<unsigned char> raw(5000);
+    for (std::size_t i = 0; i < raw.size(); ++i) raw[i] = static_cast<unsigned char>((i % 37) * (i % 5 == 0));
+    auto packed = mat::lz_compress(raw.data(), raw.size());
+    CHECK(packed.size() < raw.size() / 4);
+    std::vector<unsigned char> back(raw.size());
+    mat::lz_decompress(packed.data(), packed.size(), back.data(), back.size());
+    CHECK(back == raw);
+    CHECK_THROWS_AS(mat::lz_decompress(packed.data(), packed.size() - 3, back.data(), back.size()),
+                    invalid_argument);
+
+    const std::size_t n = 50;
+    SquareMat M(n, 0.0);
+    for (std::size_t i = 0; i < n; ++i) { M[i][i] = double(i); M[i][(i * 7) % n] = 0.5; }
+    TempFile sqmz(".sqmz");
+    const std::string& path = sqmz.path;
+    mat::save_compressed(M, path, 8);
+    SquareMat L = mat::load_compressed(path);
+    CHECK(same_elems(L, M));
+    CHECK(L[49][49] == doctest::Approx(49));
+
+    mat::CompressedMatFile cf(path);
+    CHECK(cf.size() == n);
+    CHECK(cf.compressed_bytes() < n * n * sizeof(double) / 4);
+    std::vector<double> rows(5 * n);
+    cf.read_rows(13, 5, rows.data());          // spans two blocks, neither whole
+    CHECK(rows[0 * n + 13] == doctest::Approx(13));
+    CHECK(rows[4 * n + 17] == doctest::Approx(17));
+    CHECK(std::equal(rows.begin(), rows.end(), static_cast<const SquareMat&>(M).data() + 13 * n));
+    CHECK_THROWS_AS(cf.read_rows(48, 3, rows.data()), invalid_argument);
+    std::remove(path.c_str());
+}
+
+// 19. Unchecked access and raw data
+TEST_CASE("Unchecked element access, row pointers and spans") {
+    SquareMat M = SquareMat::from_string("1 2,3 4");
+    CHECK(M.at_unchecked(1, 0) == doctest::Approx(3));
+    M.at_unchecked(0, 1) = 5;
+    CHECK(M[0][1] == doctest::Approx(5));
+    CHECK(M.data()[3] == doctest::Approx(4));
+    CHECK(M.row_ptr(1) == M.data() + 2);
+    double s = 0;
+    for (double v : M.row(1)) s += v;
+    CHECK(s == doctest::Approx(7));
+    const SquareMat& C = M;
+    CHECK(C.row(0).size() == 2);
+    CHECK(C.row(0)[1] == doctest::Approx(5));
+}
+
+// 20. Iterators and range views
+static_assert(std::contiguous_iterator<decltype(std::declval<SquareMat&>().begin())>);
+static_assert(std::random_access_iterator<mat::StridedIter<double>>);
+static_assert(std::random_access_iterator<mat::StridedIter<const double>>);
+
+TEST_CASE("Contiguous iterators, row/column/diagonal views") {
+    SquareMat M = SquareMat::from_string("1 2 3,4 5 6,7 8 9");
+    CHECK(std::reduce(M.begin(), M.end()) == doctest::Approx(45));
+    std::transform(M.begin(), M.end(), M.begin(), [](double v) { return v * 2; });
+    CHECK(M[2][2] == doctest::Approx(18));
+
+    auto c1 = M.col(1);
+    CHECK(c1.size() == 3);
+    CHECK(std::accumulate(c1.begin(), c1.end(), 0.0) == doctest::Approx(30));
+    auto d = M.diag();
+    CHECK(std::reduce(d.begin(), d.end()) == doctest::Approx(30));
+
+    // writes through a strided view land in the matrix
+    auto c0 = M.col(0);
+    std::sort(c0.begin(), c0.end(), std::greater<double>());
+    CHECK(M[0][0] == doctest::Approx(14));
+    CHECK(M[2][0] == doctest::Approx(2));
+    CHECK(c0.end() - c0.begin() == 3);
+
+    double row_sums = 0;
+    for (auto r : M.rows()) row_sums += std::reduce(r.begin(), r.end());
+    CHECK(row_sums == doctest::Approx(90));
+    const SquareMat& C = M;
+    CHECK(C.rows()[1][2] == doctest::Approx(12));
+    CHECK(C.col(2)[0] == doctest::Approx(6));
+}
+
+// 21. Block views
+TEST_CASE("Block views: arithmetic, transpose and multiply in place") {
+    SquareMat M = SquareMat::from_string("1 2 3 4,5 6 7 8,9 10 11 12,13 14 15 16");
+    auto tl = M.block(0, 0, 2);
+    auto br = M.block(2, 2, 2);
+    CHECK(SquareMat(tl) == SquareMat::from_string("1 2,5 6"));
+    CHECK((tl + br) == SquareMat::from_string("12 14,20 22"));
+    CHECK((tl * br)[0][0] == doctest::Approx(1*11 + 2*15));
+    CHECK((~M.block(1, 1, 2))[0][1] == doctest::Approx(10));
+    CHECK((tl * SquareMat::from_string("1 0,0 1")) == SquareMat(tl));
+    CHECK_THROWS_AS(M.block(3, 3, 2), invalid_argument);
+    CHECK_THROWS_AS(tl + M, invalid_argument);
+
+    // product written into the top-right block of the same parent
+    multiply(M.block(0, 0, 2), M.block(2, 2, 2), M.block(0, 2, 2));
+    CHECK(M[0][2] == doctest::Approx(41));
+    CHECK(M[1][3] == doctest::Approx(5*12 + 6*16));
+    CHECK_THROWS_AS(multiply(M.block(0, 0, 2), M.block(1, 1, 2), M.block(0, 1, 2)), invalid_argument);
+
+    transpose(M.block(2, 0, 2), M.block(2, 0, 2));
+    CHECK(M[2][1] == doctest::Approx(13));
+    M.block(2, 0, 2) += M.block(2, 2, 2);
+    CHECK(M[3][1] == doctest::Approx(14 + 16));
+    M.block(0, 0, 2) *= 0.5;
+    CHECK(M[1][1] == doctest::Approx(3));
+
+    SquareMat S(2, 1.0);
+    assign(M.block(1, 1, 2), S);
+    CHECK(M[2][2] == doctest::Approx(1));
+    CHECK(M.block(1, 1, 2).block(1, 1, 1)(0, 0) == doctest::Approx(1));
+}
+
+// 22. Copy-on-write storage
+TEST_CASE("Copy-on-write copies share storage until written") {
+    SquareMat A = SquareMat::from_string("1 2,3 4");
+    SquareMat plain(A);
+    CHECK_FALSE(plain.cow());
+    CHECK(static_cast<const SquareMat&>(plain).data() != static_cast<const SquareMat&>(A).data());
+
+    A.enable_cow();
+    SquareMat B(A), C = A;
+    const SquareMat& cA = A;
+    const SquareMat& cB = B;
+    CHECK(A.is_shared());
+    CHECK(cA.data() == cB.data());
+
+    B[0][0] = 10;                         // Row write detaches only B
+    CHECK(cA.data() != cB.data());
+    CHECK(A[0][0] == doctest::Approx(1));
+    CHECK(B[0][0] == doctest::Approx(10));
+    CHECK(C[0][0] == doctest::Approx(1));
+
+    SquareMat D = C;
+    ++D;
+    CHECK(C[1][1] == doctest::Approx(4));
+    CHECK(D[1][1] == doctest::Approx(5));
+    SquareMat E = C;
+    E *= C;
+    CHECK(E.cow());
+    CHECK(E == SquareMat::from_string("7 10,15 22"));
+    CHECK(C == SquareMat::from_string("1 2,3 4"));
+    SquareMat F = C;
+    SquareMat G = F++;
+    CHECK(G[0][1] == doctest::Approx(2));
+    CHECK(F[0][1] == doctest::Approx(3));
+    CHECK(C[0][1] == doctest::Approx(2));
+
+    // a mutable pointer taken while unshared must not reach later copies
+    auto escapes = [](auto take) {
+        SquareMat X = SquareMat::from_string("1 2,3 4");
+        X.enable_cow();
+        double* p = take(X);
+        SquareMat Y = X;
+        *p = 42;
+        const SquareMat& cX = X;
+        const SquareMat& cY = Y;
+        return cX[0][0] == 42 && cY[0][0] == 1 && !X.is_shared() && Y.cow();
+    };
+    CHECK(escapes([](SquareMat& X) { return X.data(); }));
+    CHECK(escapes([](SquareMat& X) { return &X[0][0]; }));
+    CHECK(escapes([](SquareMat& X) { return &X.at_unchecked(0, 0); }));
+    CHECK(escapes([](SquareMat& X) { return X.row_ptr(0); }));
+    CHECK(escapes([](SquareMat& X) { return X.row(0).data(); }));
+    CHECK(escapes([](SquareMat& X) { return X.begin(); }));
+    CHECK(escapes([](SquareMat& X) { return X.end() - 4; }));
+    CHECK(escapes([](SquareMat& X) { return (*X.rows().begin()).data(); }));
+    CHECK(escapes([](SquareMat& X) { return &*X.col(0).begin(); }));
+    CHECK(escapes([](SquareMat& X) { return &X.diag()[0]; }));
+    CHECK(escapes([](SquareMat& X) { return X.view().data(); }));
+    CHECK(escapes([](SquareMat& X) { return X.block(0, 0, 1).data(); }));
+
+    // a Row kept across the copy
+    SquareMat R = SquareMat::from_string("1 2,3 4");
+    R.enable_cow();
+    auto r = R[0];
+    SquareMat S = R;
+    r[0] = 7;
+    CHECK(static_cast<const SquareMat&>(S)[0][0] == 1);
+    CHECK(static_cast<const SquareMat&>(R)[0][0] == 7);
+
+    // const access and compound ops keep sharing
+    SquareMat H = SquareMat::from_string("1 2,3 4");
+    H.enable_cow();
+    (void)static_cast<const SquareMat&>(H).data();
+    H += H;
+    SquareMat K = H;
+    CHECK(H.is_shared());
+    CHECK(static_cast<const SquareMat&>(K)[1][1] == 8);
+}
+
+// 23. Symmetric packed matrices
+TEST_CASE("SymmetricMat packed storage, SYRK, SYMM and determinant") {
+    SquareMat A = SquareMat::from_string("2 1 0,1 3 1,0 1 4");
+    mat::SymmetricMat S(A);
+    CHECK(S.packed() == 6);
+    CHECK(S(2, 1) == doctest::Approx(1));
+    S(0, 2) = 0.5;
+    CHECK(S(2, 0) == doctest::Approx(0.5));
+    CHECK_THROWS_AS(mat::SymmetricMat(SquareMat::from_string("1 2,3 4")), invalid_argument);
+    CHECK_THROWS_AS(S(3, 0), invalid_argument);
+
+    SquareMat B = SquareMat::from_string("1 2 3,4 5 6,7 8 10");
+    mat::SymmetricMat G = mat::SymmetricMat::syrk(B);
+    SquareMat full = B * ~B;
+    CHECK((G.to_square() - full) == SquareMat(3, 0.0));
+    CHECK(G(0, 2) == doctest::Approx(full[0][2]));
+
+    SquareMat P = S * B;
+    SquareMat Q = S.to_square() * B;
+    for (std::size_t i = 0; i < 3; ++i)
+        for (std::size_t j = 0; j < 3; ++j) CHECK(P[i][j] == doctest::Approx(Q[i][j]));
+
+    CHECK(!mat::SymmetricMat(A) == doctest::Approx(!A));              // SPD path
+    SquareMat I = SquareMat::from_string("0 1,1 0");
+    CHECK(!mat::SymmetricMat(I) == doctest::Approx(-1));              // indefinite fallback
+    CHECK((S + S)(1, 1) == doctest::Approx(6));
+    CHECK((S * 2.0 - S)(0, 2) == doctest::Approx(0.5));
+}
+
+// 24. Cholesky
+TEST_CASE("Cholesky factorization, det, log_det and solve") {
+    SquareMat A = SquareMat::from_string("4 2 0.4,2 5 1,0.4 1 3");
+    mat::Cholesky ch(A);
+    const SquareMat& L = ch.factor();
+    CHECK(L[0][1] == doctest::Approx(0));
+    CHECK(same_elems(L * ~L, A, 1e-12));
+    CHECK(ch.det() == doctest::Approx(!A));
+    CHECK(ch.log_det() == doctest::Approx(std::log(ch.det())));
+
+    SquareMat B = SquareMat::from_string("1 0 2,0 1 3,4 5 6");
+    SquareMat X = ch.solve(B);
+    SquareMat R = A * X - B;
+    for (double v : static_cast<const SquareMat&>(R)) CHECK(v == doctest::Approx(0).epsilon(1e-12));
+
+    CHECK(mat::Cholesky::is_spd(A));
+    CHECK_FALSE(mat::Cholesky::is_spd(SquareMat::from_string("1 2,2 1")));   // symmetric, indefinite
+    CHECK_THROWS_AS(mat::Cholesky(SquareMat::from_string("1 2,3 4")), invalid_argument);
+
+    // blocked path (n > panel width) agrees with elimination
+    const std::size_t n = 150;
+    SquareMat M(n, 0.0);
+    for (std::size_t i = 0; i < n; ++i)
+        for (std::size_t j = 0; j < n; ++j) M[i][j] = 1.0 / double(1 + i + j) + (i == j ? 2.0 : 0.0);
+    mat::Cholesky big(M);
+    SquareMat P(M);                                      // row swap: not symmetric, det negated
+    std::swap_ranges(P.row(0).begin(), P.row(0).end(), P.row(1).begin());
+    CHECK(!P < 0);
+    CHECK(big.log_det() == doctest::Approx(std::log(-!P)));
+    CHECK(!M == doctest::Approx(-!P));
+    CHECK(!SquareMat::from_string("1 2,2 1") == doctest::Approx(-3));      // fallback to elimination
+
+    // const ! must not factor a copy-on-write operand's shared buffer
+    SquareMat C = SquareMat::from_string("4 2,2 3");
+    C.enable_cow();
+    SquareMat Ccopy(C);
+    CHECK(!C == doctest::Approx(8));
+    CHECK(!C == doctest::Approx(8));
+    CHECK(same_elems(C, SquareMat::from_string("4 2,2 3")));
+    CHECK(same_elems(Ccopy, SquareMat::from_string("4 2,2 3")));
+}
+
+// 25. Sparse CSR matrices
+TEST_CASE("SparseSquareMat products, transpose, element-wise ops and power") {
+    using mat::SparseSquareMat;
+    const std::size_t n = 200;                 // > one row chunk, exercises both accumulators
+    SquareMat D(n, 0.0);
+    for (std::size_t i = 0; i < n; ++i) {
+        D[i][i] = 2.0;
+        D[i][(i * 7 + 3) % n] += 1.0;
+        if (i % 50 == 0) for (std::size_t j = 0; j < n; j += 2) D[i][j] += 0.25;   // a few dense rows
+    }
+    SparseSquareMat S(D);
+    CHECK(S.nnz() < n * n / 5);
+    CHECK(S(0, 0) == doctest::Approx(2.25));
+    CHECK(S.to_dense() == D);
+
+    auto same = [&](const SquareMat& X, const SquareMat& Y) {
+        for (std::size_t i = 0; i < n; ++i)
+            for (std::size_t j = 0; j < n; ++j)
+                if (std::fabs(X[i][j] - Y[i][j]) > 1e-9) return false;
+        return true;
+    };
+    CHECK(same((S * S).to_dense(), D * D));
+    CHECK(same(S * D, D * D));
+    CHECK(same(D * S, D * D));
+    CHECK(same((~S).to_dense(), ~D));
+    S.build_csc();
+    CHECK(same((~S).to_dense(), ~D));
+    CHECK(same((S ^ 3).to_dense(), D ^ 3));
+    CHECK(same((S ^ 0).to_dense(), D ^ 0));
+    CHECK(same((S + ~S).to_dense(), D + ~D));
+    CHECK(same((S - S * 0.5).to_dense(), D * 0.5));
+    CHECK(same((S % ~S).to_dense(), D % ~D));
+
+    auto T = SparseSquareMat::from_triplets(3, {{0, 1, 1.0}, {2, 0, 4.0}, {0, 1, 2.0}});
+    CHECK(T.nnz() == 2);
+    CHECK(T(0, 1) == doctest::Approx(3));
+    CHECK_THROWS_AS(SparseSquareMat::from_triplets(3, {{3, 0, 1.0}}), invalid_argument);
+    CHECK_THROWS_AS(S * T, invalid_argument);
+}
+
+// 26. Structure detection and structured kernels
+TEST_CASE("Structure detection drives *, ^ and ! dispatch") {
+    using mat::Structure;
+    CHECK(SquareMat::from_string("2 0,0 3").structure().kind == Structure::Diagonal);
+    CHECK(SquareMat::from_string("1 2,0 3").structure().kind == Structure::Upper);
+    CHECK(SquareMat::from_string("1 0,2 3").structure().kind == Structure::Lower);
+    CHECK(SquareMat::from_string("1 2,3 4").structure().kind == Structure::General);
+
+    const std::size_t n = 40;
+    SquareMat T(n, 0.0), U(n, 0.0), G(n, 0.0);
+    for (std::size_t i = 0; i < n; ++i)
+        for (std::size_t j = 0; j < n; ++j) {
+            if (j + 1 >= i && j <= i + 2) T[i][j] = double((i * 3 + j) % 5) + (i == j ? 3.0 : 0.0);
+            if (j >= i) U[i][j] = 1.0 + double((i + j) % 3);
+            G[i][j] = double((i * 7 + j * 3) % 11) - 5.0;
+        }
+    Structure st = T.structure();
+    CHECK(st.kind == Structure::Banded);
+    CHECK(st.lower == 1);
+    CHECK(st.upper == 2);
+    CHECK(U.structure().kind == Structure::Upper);
+
+    // structured products agree with the general kernel (via a dense operand)
+    auto close = [&](const SquareMat& X, const SquareMat& Y) {
+        for (std::size_t i = 0; i < n; ++i)
+            for (std::size_t j = 0; j < n; ++j)
+                if (std::fabs(X[i][j] - Y[i][j]) > 1e-6 * (1 + std::fabs(Y[i][j]))) return false;
+        return true;
+    };
+    SquareMat I = SquareMat(n, 0.0) ^ 0;
+    CHECK(close(T * T, (T + G) * T - G * T));
+    CHECK(close(I * G, G));
+    CHECK(close(U * T, U * (T + G) - U * G));
+    CHECK(close(G * T, G * (T + G) - G * G));
+    // T^3 against a plain triple loop that bypasses every structured kernel
+    const SquareMat& cT = T;
+    SquareMat T2(n, 0.0), T3(n, 0.0);
+    for (std::size_t i = 0; i < n; ++i)
+        for (std::size_t k = 0; k < n; ++k)
+            for (std::size_t j = 0; j < n; ++j) T2.at_unchecked(i, j) += cT[i][k] * cT[k][j];
+    const SquareMat& cT2 = T2;
+    for (std::size_t i = 0; i < n; ++i)
+        for (std::size_t k = 0; k < n; ++k)
+            for (std::size_t j = 0; j < n; ++j) T3.at_unchecked(i, j) += cT2[i][k] * cT[k][j];
+    CHECK(close(T ^ 3, T3));
+
+    // banded determinant matches elimination on a row-permuted (general) copy
+    SquareMat P(T);
+    std::swap_ranges(P.row(0).begin(), P.row(0).end(), P.row(n - 1).begin());
+    CHECK(P.structure().kind == Structure::General);
+    CHECK(!T == doctest::Approx(-!P));
+    CHECK(!U == doctest::Approx(std::pow(1.0, 14) * std::pow(2.0, 13) * std::pow(3.0, 13)));
+
+    SquareMat D = SquareMat::from_string("2 0,0 -3");
+    CHECK(same_elems(D ^ 5, SquareMat::from_string("32 0,0 -243")));
+}
+
+// 27. Vectors and GEMV
+TEST_CASE("Vec, matrix-vector products and power iteration") {
+    using mat::Vec;
+    SquareMat A = SquareMat::from_string("1 2 3,4 5 6,7 8 10");
+    Vec x = Vec::from_string("1, -1 2");
+    Vec y = A * x;
+    CHECK(y[0] == doctest::Approx(5));
+    CHECK(y[2] == doctest::Approx(19));
+    Vec t = mat::trans(A) * x;
+    Vec t2 = (~A) * x;
+    Vec t3 = x * A;
+    for (std::size_t i = 0; i < 3; ++i) {
+        CHECK(t[i] == doctest::Approx(t2[i]));
+        CHECK(t[i] == doctest::Approx(t3[i]));
+    }
+    Vec z(3, 1.0);
+    mat::gemv(2.0, A, x, -1.0, z);
+    CHECK(z[1] == doctest::Approx(2 * (4 - 5 + 12) - 1));
+    CHECK_THROWS_AS(A * Vec(2), invalid_argument);
+    CHECK_THROWS_AS(x[3], invalid_argument);
+    CHECK(x.dot(x) == doctest::Approx(6));
+
+    // larger than the parallel threshold, batch of 6 (one group of four + two)
+    const std::size_t n = 300;
+    SquareMat B(n, 0.0);
+    for (std::size_t i = 0; i < n; ++i)
+        for (std::size_t j = 0; j < n; ++j) B[i][j] = double((i + 2 * j) % 7) - 3.0;
+    std::vector<Vec> xs;
+    for (int k = 0; k < 6; ++k) {
+        Vec v(n);
+        for (std::size_t i = 0; i < n; ++i) v[i] = double((i * (k + 1)) % 5);
+        xs.push_back(v);
+    }
+    auto ys = mat::multiply(B, xs);
+    for (int k = 0; k < 6; ++k) {
+        Vec ref = B * xs[k];
+        Vec refT = mat::trans(~B) * xs[k];
+        CHECK((ys[k] - ref).norm() == doctest::Approx(0));
+        CHECK((refT - ref).norm() == doctest::Approx(0));
+    }
+
+    SquareMat S = SquareMat::from_string("2 1,1 3");
+    auto ev = mat::power_iteration(S);
+    CHECK(ev.converged);
+    CHECK(ev.value == doctest::Approx((5 + std::sqrt(5.0)) / 2));
+    Vec r = S * ev.vector - ev.vector * ev.value;
+    CHECK(r.norm() < 1e-8);
+}
+
+// 28. GEMM
+TEST_CASE("gemm, fused accumulate and in-place *=") {
+    using mat::Trans;
+    auto same = [](const SquareMat& x, const SquareMat& y) {   // == only compares sums
+        for (std::size_t k = 0; k < x.size() * x.size(); ++k)
+            if (std::fabs(x.data()[k] - y.data()[k]) > 1e-9) return false;
+        return true;
+    };
+    SquareMat A = SquareMat::from_string("1 2 0,3 -1 4,2 5 1");
+    SquareMat B = SquareMat::from_string("0 1 2,1 0 -3,4 2 1");
+    SquareMat C = SquareMat::from_string("1 1 1,1 1 1,1 1 1");
+
+    SquareMat R = C;
+    mat::gemm(2.0, A, B, 0.5, R);
+    CHECK(same(R, A * B * 2.0 + C * 0.5));
+    for (Trans ta : {Trans::No, Trans::Yes})
+        for (Trans tb : {Trans::No, Trans::Yes}) {
+            SquareMat got(3, 7.0);
+            mat::gemm(1.0, A, B, 0.0, got, ta, tb);
+            SquareMat want = (ta == Trans::Yes ? ~A : A) * (tb == Trans::Yes ? ~B : B);
+            for (std::size_t i = 0; i < 9; ++i)
+                CHECK(got.data()[i] == doctest::Approx(want.data()[i]));
+        }
+
+    SquareMat P = C;
+    P += mat::prod(A, B);
+    P -= 3.0 * mat::prod(B, A);
+    CHECK(same(P, C + A * B - B * A * 3.0));
+
+    // aliasing: C is A, C is B, both, and Aᵀ
+    SquareMat X = A;  X *= B;  CHECK(same(X, A * B));
+    SquareMat Y = B;  mat::gemm(1.0, A, Y, 0.0, Y);  CHECK(same(Y, A * B));
+    SquareMat Z = A;  Z *= Z;  CHECK(same(Z, A * A));
+    SquareMat W = A;  mat::gemm(1.0, W, B, 0.0, W, Trans::Yes);  CHECK(same(W, ~A * B));
+    CHECK_THROWS_AS(mat::gemm(1.0, A, SquareMat(2), 0.0, C), invalid_argument);
+
+    // copy-on-write source keeps its value
+    SquareMat S = A;  S.enable_cow();
+    SquareMat T = S;  T *= B;
+    CHECK(same(S, A));
+    CHECK(same(T, A * B));
+
+    // banded operands, above the parallel threshold
+    const std::size_t n = 150;
+    SquareMat L(n, 0.0), G(n, 0.0);
+    for (std::size_t i = 0; i < n; ++i)
+        for (std::size_t j = 0; j < n; ++j) {
+            if (i <= j + 2 && j <= i + 1) L[i][j] = double((i + j) % 5) + 1.0;
+            G[i][j] = double((3 * i + j) % 7) - 3.0;
+        }
+    for (Trans ta : {Trans::No, Trans::Yes})
+        for (Trans tb : {Trans::No, Trans::Yes}) {
+            SquareMat got(n, 1.0);
+            mat::gemm(1.0, L, G, 1.0, got, ta, tb);
+            SquareMat want = (ta == Trans::Yes ? ~L : L) * (tb == Trans::Yes ? ~G : G) + SquareMat(n, 1.0);
+            CHECK(same(got, want));
+            SquareMat got2(n, 0.0);
+            mat::gemm(1.0, G, L, 0.0, got2, ta, tb);
+            CHECK(same(got2, (ta == Trans::Yes ? ~G : G) * (tb == Trans::Yes ? ~L : L)));
+        }
+}
+
+// 29. Hardware counter instrumentation
+TEST_CASE("perf scopes aggregate per operator and size class") {
+    const bool was = mat::perf::enabled();
+    mat::perf::reset();
+    SquareMat A = SquareMat::from_string("4 1 2,1 5 3,2 0 6");
+    SquareMat B(20, 1.0);
+    for (std::size_t i = 0; i < 20; ++i) B[i][i] = 30.0 + double(i % 3);
+    B[0][19] = 2.0;                         // general, not symmetric: LU path
+    mat::perf::enable(false);
+    (void)(A * A);                          // not recorded while disabled
+    mat::perf::enable();
+    (void)(A * A);
+    (void)(A * A);
+    (void)(B * B);
+    (void)!B;
+    mat::perf::enable(was);
+
+    auto find = [](const std::vector<mat::perf::Entry>& es, const std::string& op, std::size_t cls) {
+        for (const auto& e : es) if (e.op == op && e.size_class == cls) return e;
+        return mat::perf::Entry{};
+    };
+    auto es = mat::perf::snapshot();
+    CHECK(find(es, "mul", 4).calls == 2);
+    CHECK(find(es, "mul", 32).calls == 1);
+    CHECK(find(es, "det", 32).calls == 1);
+    CHECK(find(es, "lu", 32).calls == 1);
+    if (mat::perf::available()) CHECK(find(es, "mul", 32).instructions > 0);
+
+    std::ostringstream out;
+    mat::perf::report(out);
+    CHECK(out.str().find("lu") != std::string::npos);
+    mat::perf::reset();
+    CHECK(mat::perf::snapshot().empty());
+}
+
+// 30. Allocation telemetry
+TEST_CASE("allocation telemetry per operator and site") {
+    auto count = [](const std::string& op, const std::string& site) {
+        for (const auto& e : mat::mem::snapshot()) if (e.op == op && e.site == site) return e;
+        return mat::mem::Entry{};
+    };
+    const bool was = mat::mem::enabled();
+    SquareMat A = SquareMat::from_string("4 1 2,1 5 3,2 0 6");
+    SquareMat B = SquareMat::from_string("1 0 0,2 1 0,3 2 1");
+    SquareMat keep(3, 1.0);
+    mat::mem::enable();
+    mat::mem::reset();
+    {
+        SquareMat C = A + B;                 // one temporary, returned in place
+        SquareMat D(3);
+        D = A * B;                           // product, then a copy into D
+        (void)!A;                            // LU scratch
+    }
+    mat::mem::enable(false);
+
+    CHECK(count("add", "ctor").allocs == 1);
+    CHECK(count("add", "ctor").bytes == 9 * sizeof(double));
+    CHECK(count("mul", "ctor").allocs == 1);
+    CHECK(count("-", "copy").allocs == 1);
+    CHECK(count("-", "ctor").allocs == 1);
+    CHECK(count("lu", "lu_scratch").frees == 1);
+    auto t = mat::mem::totals();
+    CHECK(t.allocs == 5);
+    CHECK(t.frees == t.allocs);
+    CHECK(t.live_bytes == 0);
+    CHECK(t.peak_bytes == std::int64_t(3 * 9 * sizeof(double)));   // C, D and one temporary
+
+    // disabled: nothing recorded; buffers from before reset() are ignored when freed
+    { SquareMat E = A + B; (void)E; }
+    CHECK(count("add", "ctor").allocs == 1);
+    keep = SquareMat(3, 2.0);
+    CHECK(mat::mem::totals().frees == 5);
+
+    std::ostringstream out;
+    mat::mem::report(out);
+    CHECK(out.str().find("lu_scratch") != std::string::npos);
+    mat::mem::reset();
+    CHECK(mat::mem::totals().allocs == 0);
+    mat::mem::enable(was);
+}
+
+// 31. Tracing spans
+TEST_CASE("trace spans export as Chrome trace JSON") {
+    SquareMat A(150, 1.0);
+    for (std::size_t i = 0; i < 150; ++i) A[i][i] = 200.0;
+    const bool was = mat::trace::enabled();
+    mat::trace::clear();
+    mat::trace::enable();
+    (void)(A * A);
+    mat::gemm(1.0, A, A, 0.0, A);            // parallel rows: chunk spans on workers
+    (void)SquareMat::from_string("1 2,3 4");
+    mat::trace::enable(false);
+    (void)(~A);                              // not recorded
+
+    std::ostringstream out;
+    mat::trace::write_json(out);
+    const std::string j = out.str();
+    CHECK(j.rfind("{\"displayTimeUnit\":\"ns\",\"traceEvents\":[", 0) == 0);
+    if (mat::trace::compiled()) {
+        CHECK(j.find("\"name\":\"mul\"") != std::string::npos);
+        CHECK(j.find("\"name\":\"gemm\"") != std::string::npos);
+        if (mat::ThreadPool::instance().size() > 0)
+            CHECK(j.find("\"name\":\"chunk\"") != std::string::npos);
+        CHECK(j.find("\"name\":\"parse\"") != std::string::npos);
+        CHECK(j.find("\"name\":\"transpose\"") == std::string::npos);
+
+        // rings of exited threads are reused, not one more per thread
+        auto rings = [] {
+            std::ostringstream o;
+            mat::trace::write_json(o);
+            const std::string t = o.str();
+            std::size_t count = 0;
+            for (std::size_t p = t.find("thread_name"); p != std::string::npos; p = t.find("thread_name", p + 1)) ++count;
+            return count;
+        };
+        mat::trace::enable();
+        std::thread([] { (void)SquareMat::from_string("1"); }).join();
+        const std::size_t before = rings();
+        for (int k = 0; k < 20; ++k) std::thread([] { (void)SquareMat::from_string("1"); }).join();
+        mat::trace::enable(false);
+        CHECK(rings() == before);
+    } else {
+        CHECK_FALSE(mat::trace::enabled());
+        CHECK(j.find("\"ph\":\"X\"") == std::string::npos);
+    }
+    mat::trace::enable(was);
+}
+
+// 32. Async operators
+TEST_CASE("async operators return futures and honour cancellation") {
+    SquareMat A = SquareMat::from_string("2 1 0,1 3 1,0 1 4");
+    SquareMat B = SquareMat::from_string("1 2 3,0 1 4,5 6 0");
+    auto fm = mat::async_multiply(A, B);
+    auto fd = mat::async_det(B);
+    auto fp = mat::async_pow(B, 5);
+    SquareMat M = fm.get(), P = fp.get();
+    SquareMat wantM = A * B, wantP = B ^ 5;
+    for (std::size_t i = 0; i < 9; ++i) {
+        CHECK(M.data()[i] == doctest::Approx(wantM.data()[i]));
+        CHECK(P.data()[i] == doctest::Approx(wantP.data()[i]));
+    }
+    CHECK(fd.get() == doctest::Approx(!B));
+    CHECK(mat::async_det(A).get() == doctest::Approx(!A));   // SPD fast path
+
+    // a copy-on-write operand shares the caller's buffer: it must stay intact
+    SquareMat S = SquareMat::from_string("4 2,2 3");
+    S.enable_cow();
+    auto fs = mat::async_det(S);
+    CHECK(fs.get() == doctest::Approx(8));
+    CHECK(S[0][0] == 4);
+    CHECK(S[0][1] == 2);
+    CHECK(S[1][0] == 2);
+    CHECK(S[1][1] == 3);
+    CHECK(!S == doctest::Approx(8));
+
+    // completion callback sees the result before the future is ready
+    std::atomic<bool> called{false};
+    double seen = 0;
+    auto fc = mat::async_det(B, {}, [&](const double* r, std::exception_ptr e) {
+        if (r && !e) seen = *r;
+        called = true;
+    });
+    const double got = fc.get();
+    CHECK(got == doctest::Approx(seen));
+    CHECK(called);
+
+    // errors and cancellation travel through the future
+    CHECK_THROWS_AS(mat::async_multiply(A, SquareMat(2)).get(), invalid_argument);
+    mat::CancelToken tok;
+    tok.cancel();
+    bool failed = false;
+    auto fx = mat::async_pow(B, 9, tok, [&](const SquareMat* r, std::exception_ptr e) { failed = !r && e; });
+    CHECK_THROWS_AS(fx.get(), mat::Cancelled);
+    CHECK(failed);
+
+    // cancelling a running job stops it early (inline without workers)
+    if (mat::ThreadPool::instance().size() == 0) return;
+    const std::size_t n = 600;
+    SquareMat G(n, 0.0);
+    for (std::size_t i = 0; i < n; ++i)
+        for (std::size_t j = 0; j < n; ++j) G[i][j] = double((7 * i + 3 * j) % 11) + (i == j ? 50.0 : 0.0);
+    using clock = std::chrono::steady_clock;
+    auto t0 = clock::now();
+    (void)mat::async_det(G).get();
+    const auto full = clock::now() - t0;
+
+    // the elimination scratch appearing in the telemetry means the job is running
+    const bool mem_was = mat::mem::enabled();
+    mat::mem::reset();
+    mat::mem::enable();
+    mat::CancelToken stop;
+    t0 = clock::now();
+    auto slow = mat::async_det(G, stop);
+    auto started = [] {
+        for (const auto& e : mat::mem::snapshot())
+            if (e.op == "async_det" && e.site == "lu_scratch" && e.allocs > 0) return true;
+        return false;
+    };
+    while (!started() && slow.wait_for(std::chrono::microseconds(50)) != std::future_status::ready) {}
+    stop.cancel();
+    CHECK_THROWS_AS(slow.get(), mat::Cancelled);
+    const auto cut = clock::now() - t0;
+    mat::mem::enable(mem_was);
+    CHECK(started());
+    CHECK(cut < full / 2);
+}
+
+// 33. Coroutine pipeline
+TEST_CASE("coroutine pipeline with bounded channels") {
+    std::ostringstream text;
+    std::vector<double> dets;
+    for (int k = 0; k < 40; ++k) {
+        SquareMat m(4, 0.0);
+        for (std::size_t i = 0; i < 4; ++i) m[i][i] = double(k % 5 + 1) + double(i);
+        m[0][3] = double(k);
+        dets.push_back(!m);
+        text << "4 " << m << '\n';
+    }
+    double want = 0;
+    for (double d : dets) want += d;
+
+    std::istringstream in(text.str());
+    mat::MatReader reader(in);
+    mat::Channel<SquareMat> parsed(2);
+    mat::Channel<double>    results(2, 3);          // three parallel det stages
+    double total = 0;
+    std::size_t seen = 0;
+    mat::Pipeline p;
+    p.add(mat::source(reader, parsed));
+    for (int w = 0; w < 3; ++w)
+        p.add(mat::stage(parsed, results, [](SquareMat m) { return !m; }));
+    p.add(mat::sink(results, [&](double d) { total += d; ++seen; }));
+    p.run();
+    CHECK(seen == 40);
+    CHECK(total == doctest::Approx(want));
+
+    // a failing stage aborts the channels around it and run() rethrows
+    std::istringstream in2(text.str());
+    mat::MatReader reader2(in2);
+    mat::Channel<SquareMat> a(1);
+    mat::Channel<SquareMat> b(1);
+    std::size_t got = 0;
+    mat::Pipeline q;
+    q.add(mat::source(reader2, a));
+    q.add(mat::stage(a, b, [n = 0](SquareMat m) mutable {
+        if (++n == 5) throw std::runtime_error("bad matrix");
+        return m;
+    }));
+    q.add(mat::sink(b, [&](const SquareMat&) { ++got; }));
+    CHECK_THROWS_AS(q.run(), std::runtime_error);
+    CHECK(got < 5);
+    CHECK_THROWS_AS(mat::Channel<int>(0), invalid_argument);
+
+    // run() from inside the only worker's task: the joining caller runs the stages
+    mat::ThreadPool one(1);
+    std::istringstream in3(text.str());
+    mat::MatReader reader3(in3);
+    mat::Channel<SquareMat> c(2);
+    double total3 = 0;
+    mat::Pipeline r(one);
+    r.add(mat::source(reader3, c));
+    r.add(mat::sink(c, [&](const SquareMat& m) { total3 += !m; }));
+    std::promise<void> finished;
+    one.submit([&] {
+        try { r.run(); finished.set_value(); } catch (...) { finished.set_exception(std::current_exception()); }
+    });
+    finished.get_future().get();
+    CHECK(total3 == doctest::Approx(want));
+}
+
+// 34. Deferred expression graph
+TEST_CASE("expression graph evaluates independent nodes with buffer reuse") {
+    auto same = [](const SquareMat& x, const SquareMat& y) {
+        if (x.size() != y.size()) return false;
+        for (std::size_t i = 0; i < x.size(); ++i)
+            for (std::size_t j = 0; j < x.size(); ++j)
+                if (std::fabs(x[i][j] - y[i][j]) > 1e-9 * (1 + std::fabs(y[i][j]))) return false;
+        return true;
+    };
+    SquareMat A = SquareMat::from_string("1 2 0,0 1 1,1 0 1");
+    SquareMat B = SquareMat::from_string("2 0 1,1 1 0,0 1 1");
+    SquareMat C = SquareMat::from_string("1 1 1,0 2 1,1 0 3");
+    SquareMat D = SquareMat::from_string("0 1 0,1 0 1,1 1 1");
+
+    mat::Graph g;
+    mat::Expr a = g.input(A), b = g.input(B), c = g.input(C), d = g.input(D);
+    mat::Scalar s = mat::det(a * b) + mat::det(c * d);
+    CHECK(s.eval() == doctest::Approx(!(A * B) + !(C * D)));
+
+    mat::Expr p = (a ^ 8) * (b ^ 8);
+    CHECK(same(p.eval(), (A ^ 8) * (B ^ 8)));
+    // A², A⁴, B², B⁴ die early: their buffers serve later nodes
+    CHECK(g.stats().buffers_reused > 0);
+
+    mat::Expr e = ~(a - b) * 2.0 + (c ^ 0);
+    SquareMat want = ~(A - B) * 2.0 + (C ^ 0);
+    CHECK(same(e.eval(), want));
+    CHECK(same(e.eval(), want));              // cached
+
+    // several targets in one pass; a shared subexpression runs once
+    mat::Expr ab = a * b;
+    mat::Expr x = ab + c, y = ab - c;
+    const std::size_t before = g.stats().nodes_run;
+    g.eval({x, y});
+    CHECK(g.stats().nodes_run - before == 3);
+    CHECK(same(x.eval(), A * B + C));
+    CHECK(same(y.eval(), A * B - C));
+
+    SquareMat small(2, 1.0);
+    CHECK_THROWS_AS(a + g.input(small), invalid_argument);
+    mat::Graph other;
+    CHECK_THROWS_AS(a * other.input(A), invalid_argument);
+    mat::Scalar bad = mat::det(a) / (mat::det(a) - mat::det(a));
+    CHECK_THROWS_AS(bad.eval(), invalid_argument);
+
+    // a node read by both a determinant and another op (SPD: Cholesky path)
+    mat::Graph h;
+    SquareMat S0 = SquareMat::from_string("4 2,2 3");
+    mat::Expr P = h.input(S0) * h.input(SquareMat::from_string("1 0,0 1"));
+    mat::Scalar dp = mat::det(P);
+    mat::Expr PP = P + P;
+    h.eval({PP}, {dp});
+    CHECK(dp.eval() == doctest::Approx(8));
+    CHECK(same(PP.eval(), S0 * 2.0));
+    CHECK(same(P.eval(), S0));
+    CHECK(mat::det(h.input(S0)).eval() == doctest::Approx(8));
+    CHECK(S0[1][0] == 2);
+
+    // evaluated from inside the only worker's task: joining runs the nodes
+    mat::ThreadPool one(1);
+    mat::Graph in_task(one);
+    mat::Expr ia = in_task.input(A), ib = in_task.input(B), ic = in_task.input(C);
+    mat::Expr iq = (ia * ib) + (ib * ic) + (ic ^ 3);
+    std::promise<SquareMat> got;
+    one.submit([&] {
+        try { got.set_value(iq.eval()); } catch (...) { got.set_exception(std::current_exception()); }
+    });
+    CHECK(same(got.get_future().get(), A * B + B * C + (C ^ 3)));
+}
+
+// 35. Work-stealing scheduler
+TEST_CASE("work-stealing fork/join and parallel kernels") {
+    mat::ThreadPool pool(3);
+
+    // uneven recursive tree: fib through nested task groups
+    std::function<long(int)> fib = [&](int k) -> long {
+        if (k < 12) return k < 2 ? k : fib(k-1) + fib(k-2);
+        long x = 0, y = 0;
+        mat::TaskGroup tg(pool);
+        tg.run([&] { x = fib(k-1); });
+        y = fib(k-2);
+        tg.wait();
+        return x + y;
+    };
+    CHECK(fib(22) == 17711);
+
+    // nested loops with skewed work still cover every cell once
+    std::vector<std::atomic<int>> hits(64 * 64);
+    pool.parallel_for(0, 64, 1, [&](std::size_t lo, std::size_t hi) {
+        for (std::size_t i = lo; i < hi; ++i)
+            pool.parallel_for(0, 64, 1 + i % 7, [&](std::size_t a, std::size_t b) {
+                for (std::size_t j = a; j < b; ++j) hits[i*64 + j]++;
+            });
+    });
+    bool once = true;
+    for (auto& h : hits) once = once && h.load() == 1;
+    CHECK(once);
+
+    std::vector<int> cells(100 * 70, 0);
+    std::atomic<bool> small_tiles{true};
+    pool.parallel_for_2d(0, 100, 0, 70, 8, [&](std::size_t r0, std::size_t r1, std::size_t c0, std::size_t c1) {
+        if (r1 - r0 > 8 || c1 - c0 > 8) small_tiles = false;
+        for (std::size_t r = r0; r < r1; ++r)
+            for (std::size_t c = c0; c < c1; ++c) cells[r*70 + c]++;
+    });
+    CHECK(small_tiles);
+    CHECK(std::count(cells.begin(), cells.end(), 1) == 100 * 70);
+
+    int left = 0, right = 0;
+    mat::fork_join([&] { left = 1; }, [&] { right = 2; });
+    CHECK(left + right == 3);
+    CHECK_THROWS_AS(mat::fork_join([] {}, [] { throw invalid_argument("boom"); }), invalid_argument);
+    {
+        mat::TaskGroup tg(pool);
+        tg.run([] { throw std::runtime_error("late"); });
+        CHECK_THROWS_AS(tg.wait(), std::runtime_error);
+        tg.wait();                                   // error reported once
+    }
+
+    // a joiner runs only its own group's tasks (and nested ones), never an
+    // unrelated submit() job queued ahead of them
+    {
+        mat::ThreadPool one(1);
+        std::atomic<bool> release{false}, unrelated_done{false};
+        std::atomic<std::thread::id> unrelated_on{};
+        one.submit([&] { while (!release) std::this_thread::yield(); });   // occupy the worker
+        one.submit([&] { unrelated_on = std::this_thread::get_id(); unrelated_done = true; });
+        int mine = 0, nested = 0;
+        mat::TaskGroup tg(one);
+        tg.run([&] {
+            mat::TaskGroup inner(one);
+            inner.run([&] { nested = 1; });
+            inner.wait();
+            mine = 1;
+        });
+        tg.wait();                                   // worker is busy: we run tg's tasks
+        CHECK(mine == 1);
+        CHECK(nested == 1);
+        CHECK_FALSE(unrelated_done);
+        release = true;
+        while (!unrelated_done) std::this_thread::yield();
+        CHECK(unrelated_on.load() != std::this_thread::get_id());
+    }
+
+    // *, ~ and the LU take their parallel paths from n = 256
+    const std::size_t n = 260;
+    SquareMat L(n, 0.0), U(n, 0.0), B(n, 0.0);
+    double want = 1.0;
+    for (std::size_t i = 0; i < n; ++i) {
+        L[i][i] = 1.0;
+        U[i][i] = (i % 3 == 0) ? -1.0 : 1.0 + double(i % 2) * 0.5 - double(i % 5 == 0) * 0.25;
+        want *= U[i][i];
+        for (std::size_t j = 0; j < i; ++j) L[i][j] = (double((i*7 + j*3) % 11) / 11.0 - 0.5) * 0.2;
+        for (std::size_t j = i + 1; j < n; ++j) U[i][j] = double((i + 2*j) % 13) / 13.0;
+        for (std::size_t j = 0; j < n; ++j) B[i][j] = double((i*j) % 17) - 8.0;
+    }
+    SquareMat A = L * U;
+    CHECK(A[5][3] == doctest::Approx(L[5][0]*U[0][3] + L[5][1]*U[1][3] + L[5][2]*U[2][3] + U[5][3] * 0 + L[5][3]*U[3][3]));
+    CHECK(!A == doctest::Approx(want).epsilon(1e-6));
+
+    SquareMat P = A * B, T = ~B;
+    bool ok = true;
+    for (std::size_t i = 0; i < n && ok; i += 37)
+        for (std::size_t j = 0; j < n; ++j) {
+            double s = 0;
+            for (std::size_t k = 0; k < n; ++k) s += A[i][k] * B[k][j];
+            ok = ok && std::fabs(P[i][j] - s) < 1e-8 * (1 + std::fabs(s)) && T[j][i] == B[i][j];
+        }
+    CHECK(ok);
+}
+
+// 36. NUMA placement
+TEST_CASE("NUMA placement, parallel first touch and pinned workers") {
+    using mat::numa::Placement;
+    CHECK(mat::numa::nodes() >= 1);
+    const Placement was = mat::numa::placement();
+    const std::size_t n = 600;                       // 2.9 MB: above numa::kMinBytes
+    std::vector<double> raw(n*n);
+    for (std::size_t i = 0; i < raw.size(); ++i) raw[i] = double(i % 101) - 50.0;
+
+    for (Placement p : {Placement::FirstTouch, Placement::Interleave}) {
+        mat::numa::set_placement(p);
+        SquareMat A(n, 2.5), B(n, raw.data()), C(B);
+        C[0][0] = 7.0;                               // deep copy
+        bool ok = B[0][0] == raw[0];
+        for (std::size_t i = 0; i < n && ok; ++i)
+            for (std::size_t j = 0; j < n; ++j)
+                ok = ok && A[i][j] == 2.5 && B[i][j] == raw[i*n + j]
+                        && (i + j == 0 || C[i][j] == raw[i*n + j]);
+        CHECK(ok);
+        CHECK(mat::numa::node_of(B.data()) < int(mat::numa::nodes()));
+#ifdef __linux__
+        CHECK(mat::numa::node_of(B.data()) >= 0);
+        if (p == Placement::Interleave) {            // the policy mbind left on B's pages
+            int mode = -1;
+            CHECK(syscall(SYS_get_mempolicy, &mode, nullptr, 0, B.data(), MPOL_F_ADDR) == 0);
+            CHECK(mode == MPOL_INTERLEAVE);
+        }
+#endif
+    }
+    mat::numa::set_placement(was);
+    CHECK_FALSE(mat::numa::interleave(raw.data(), 16));   // not one whole page
+
+    mat::ThreadPool pinned(2, true);
+    std::atomic<int> total{0};
+    pinned.parallel_for(0, 100, 3, [&](std::size_t lo, std::size_t hi) {
+        for (std::size_t i = lo; i < hi; ++i) total += int(i);
+    });
+    CHECK(total == 4950);
+#ifdef __linux__
+    bool single = false;
+    std::thread t([&] {
+        if (!mat::numa::pin_thread(0)) { single = true; return; }
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        single = sched_getaffinity(0, sizeof set, &set) == 0 && CPU_COUNT(&set) == 1;
+    });
+    t.join();
+    CHECK(single);
+#endif
+}